@@ -3,7 +3,36 @@
 #include <string.h>
 #include <stdio.h>
 #include "devices/ide.h"
+#include "devices/timer.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Most sectors merged into one transfer. */
+#define BLOCK_MERGE_MAX 64
+
+/* A request that has waited this many ticks is dispatched next,
+   even if the elevator would have gone elsewhere. */
+#define BLOCK_DEADLINE (TIMER_FREQ / 2)
+
+/* Request queue of a block device, in C-LOOK order: the head
+   sweeps toward higher sectors and then jumps back to the lowest
+   pending one.  At most one transfer at a time is with the
+   driver; its completion, usually in the driver's interrupt
+   handler, starts the next one.  Interrupts must be off to
+   access the members. */
+struct block_queue
+  {
+    struct list requests;               /* Pending requests, by sector. */
+    struct list batch;                  /* Requests in the active transfer. */
+    struct block_request *active;       /* Transfer with the driver, or null. */
+    struct block_request merged;        /* Transfer for merged requests. */
+    block_sector_t head;                /* Sector after the last dispatched. */
+    uint8_t *merge_buffer;              /* BLOCK_MERGE_MAX sectors of memory
+                                           for merged transfers. */
+    unsigned long long merge_cnt;       /* Requests merged into another. */
+  };
 
 /* A block device. */
 struct block
@@ -19,6 +48,9 @@ struct block
 
     unsigned long long read_cnt;        /* Number of sectors read. */
     unsigned long long write_cnt;       /* Number of sectors written. */
+
+    struct block_queue *queue;          /* Request queue, or null if I/O is
+                                           passed straight to the driver. */
   };
 
 /* List of all block devices. */
@@ -28,6 +60,11 @@ static struct list all_blocks = LIST_INITIALIZER (all_blocks);
 static struct block *block_by_role[BLOCK_ROLE_CNT];
 
 static struct block *list_elem_to_block (struct list_elem *);
+static void device_read (struct block *, block_sector_t, size_t cnt, void *);
+static void device_write (struct block *, block_sector_t, size_t cnt,
+                          const void *);
+static void queue_dispatch (struct block *);
+static void complete_request (struct block_request *);
 
 /* Returns a human-readable name for the given block device
    TYPE. */
@@ -120,9 +157,7 @@ check_sector (struct block *block, block_sector_t sector)
 void
 block_read (struct block *block, block_sector_t sector, void *buffer)
 {
-  check_sector (block, sector);
-  block->ops->read (block->aux, sector, buffer);
-  block->read_cnt++;
+  block_read_range (block, sector, 1, buffer);
 }
 
 /* Write sector SECTOR to BLOCK from BUFFER, which must contain
@@ -133,10 +168,105 @@ block_read (struct block *block, block_sector_t sector, void *buffer)
 void
 block_write (struct block *block, block_sector_t sector, const void *buffer)
 {
+  block_write_range (block, sector, 1, buffer);
+}
+
+/* Verifies that the CNT sectors starting at SECTOR are all valid
+   offsets within BLOCK.  Panics if not. */
+static void
+check_range (struct block *block, block_sector_t sector, size_t cnt)
+{
+  ASSERT (cnt > 0);
   check_sector (block, sector);
-  ASSERT (block->type != BLOCK_FOREIGN);
-  block->ops->write (block->aux, sector, buffer);
-  block->write_cnt++;
+  if (cnt > block->size - sector)
+    PANIC ("Access past end of device %s (sector=%"PRDSNu", cnt=%zu, "
+           "size=%"PRDSNu")\n", block_name (block), sector, cnt, block->size);
+}
+
+/* Reads the CNT consecutive sectors starting at SECTOR from BLOCK
+   into BUFFER, which must have room for CNT * BLOCK_SECTOR_SIZE
+   bytes.  Drivers that support it receive a single request for
+   the whole range.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_read_range (struct block *block, block_sector_t sector, size_t cnt,
+                  void *buffer)
+{
+  if (block->queue != NULL || block->ops->read == NULL)
+    {
+      struct block_request r;
+      block_submit (block, &r, false, sector, cnt, buffer, NULL, NULL);
+      block_wait (&r);
+    }
+  else
+    {
+      check_range (block, sector, cnt);
+      device_read (block, sector, cnt, buffer);
+      block->read_cnt += cnt;
+    }
+}
+
+/* Writes the CNT consecutive sectors starting at SECTOR to BLOCK
+   from BUFFER, which must contain CNT * BLOCK_SECTOR_SIZE bytes.
+   Returns after the block device has acknowledged receiving the
+   data.  Drivers that support it receive a single request for
+   the whole range.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_write_range (struct block *block, block_sector_t sector, size_t cnt,
+                   const void *buffer)
+{
+  if (block->queue != NULL || block->ops->write == NULL)
+    {
+      struct block_request r;
+      block_submit (block, &r, true, sector, cnt, (void *) buffer, NULL, NULL);
+      block_wait (&r);
+    }
+  else
+    {
+      check_range (block, sector, cnt);
+      ASSERT (block->type != BLOCK_FOREIGN);
+      device_write (block, sector, cnt, buffer);
+      block->write_cnt += cnt;
+    }
+}
+
+/* Passes a read of CNT sectors starting at SECTOR straight to
+   BLOCK's driver, as a single request if the driver supports
+   it. */
+static void
+device_read (struct block *block, block_sector_t sector, size_t cnt,
+             void *buffer)
+{
+  if (block->ops->read_range != NULL)
+    block->ops->read_range (block->aux, sector, cnt, buffer);
+  else
+    {
+      size_t i;
+      for (i = 0; i < cnt; i++)
+        block->ops->read (block->aux, sector + i,
+                          (uint8_t *) buffer + i * BLOCK_SECTOR_SIZE);
+    }
+}
+
+/* Passes a write of CNT sectors starting at SECTOR straight to
+   BLOCK's driver, as a single request if the driver supports
+   it. */
+static void
+device_write (struct block *block, block_sector_t sector, size_t cnt,
+              const void *buffer)
+{
+  if (block->ops->write_range != NULL)
+    block->ops->write_range (block->aux, sector, cnt, buffer);
+  else
+    {
+      size_t i;
+      for (i = 0; i < cnt; i++)
+        block->ops->write (block->aux, sector + i,
+                           (const uint8_t *) buffer + i * BLOCK_SECTOR_SIZE);
+    }
 }
 
 /* Returns the number of sectors in BLOCK. */
@@ -164,6 +294,7 @@ block_type (struct block *block)
 void
 block_print_stats (void)
 {
+  struct list_elem *e;
   int i;
 
   for (i = 0; i < BLOCK_ROLE_CNT; i++)
@@ -176,6 +307,17 @@ block_print_stats (void)
                   block->read_cnt, block->write_cnt);
         }
     }
+
+  for (e = list_begin (&all_blocks); e != list_end (&all_blocks);
+       e = list_next (e))
+    {
+      struct block *block = list_entry (e, struct block, list_elem);
+      if (block->queue != NULL)
+        {
+          printf ("%s: %llu requests merged\n",
+                  block->name, block->queue->merge_cnt);
+        }
+    }
 }
 
 /* Registers a new block device with the given NAME.  If
@@ -200,6 +342,7 @@ block_register (const char *name, enum block_type type,
   block->aux = aux;
   block->read_cnt = 0;
   block->write_cnt = 0;
+  block->queue = NULL;
 
   printf ("%s: %'"PRDSNu" sectors (", block->name, block->size);
   print_human_readable_size ((uint64_t) block->size * BLOCK_SECTOR_SIZE);
@@ -221,3 +364,291 @@ list_elem_to_block (struct list_elem *list_elem)
           : NULL);
 }
 
+/* Asynchronous I/O. */
+
+/* Orders requests by starting sector. */
+static bool
+request_less (const struct list_elem *a_, const struct list_elem *b_,
+              void *aux UNUSED)
+{
+  const struct block_request *a = list_entry (a_, struct block_request, elem);
+  const struct block_request *b = list_entry (b_, struct block_request, elem);
+  return a->sector < b->sector;
+}
+
+/* Starts a transfer of CNT sectors starting at SECTOR between
+   BLOCK and BUFFER, a write if WRITE is true and otherwise a
+   read, and returns without waiting for it, using R to track
+   the request.  BUFFER must be in kernel virtual memory, since
+   the transfer may be carried out from an interrupt handler.
+
+   When the transfer completes, CALLBACK, if non-null, is called
+   with R and AUX.  It may run in an interrupt handler, so it
+   must not sleep; it may free R.  Without a callback, use
+   block_wait() or block_poll() to learn of completion.  R and
+   BUFFER must stay valid until then. */
+void
+block_submit (struct block *block, struct block_request *r, bool write,
+              block_sector_t sector, size_t cnt, void *buffer,
+              block_callback_func *callback, void *aux)
+{
+  enum intr_level old_level;
+
+  check_range (block, sector, cnt);
+  ASSERT (!write || block->type != BLOCK_FOREIGN);
+  ASSERT (is_kernel_vaddr (buffer));
+
+  r->block = block;
+  r->write = write;
+  r->sector = sector;
+  r->cnt = cnt;
+  r->buffer = buffer;
+  r->deadline = timer_ticks () + BLOCK_DEADLINE;
+  r->callback = callback;
+  r->aux = aux;
+  r->complete = false;
+  sema_init (&r->done, 0);
+
+  if (write)
+    block->write_cnt += cnt;
+  else
+    block->read_cnt += cnt;
+
+  if (block->queue != NULL)
+    {
+      old_level = intr_disable ();
+      list_insert_ordered (&block->queue->requests, &r->elem,
+                           request_less, NULL);
+      queue_dispatch (block);
+      intr_set_level (old_level);
+    }
+  else if (block->ops->submit != NULL)
+    {
+      old_level = intr_disable ();
+      block->ops->submit (block->aux, r);
+      intr_set_level (old_level);
+    }
+  else
+    {
+      /* The driver only does synchronous I/O, so the request is
+         complete by the time it returns. */
+      if (write)
+        device_write (block, sector, cnt, buffer);
+      else
+        device_read (block, sector, cnt, buffer);
+      complete_request (r);
+    }
+}
+
+/* Initializes R as a request that has already completed, for a
+   caller that satisfied it without going to the device but whose
+   users will block_wait() or block_poll() on it all the same. */
+void
+block_request_init_done (struct block_request *r)
+{
+  r->block = NULL;
+  r->callback = NULL;
+  r->aux = NULL;
+  r->complete = true;
+  sema_init (&r->done, 1);
+}
+
+/* Returns true if request R, submitted with block_submit(), has
+   completed. */
+bool
+block_poll (const struct block_request *r)
+{
+  return r->complete;
+}
+
+/* Waits for request R, which was submitted with block_submit()
+   without a callback, to complete. */
+void
+block_wait (struct block_request *r)
+{
+  ASSERT (r->callback == NULL);
+  sema_down (&r->done);
+  sema_up (&r->done);
+}
+
+/* Called by a block device driver when it has completed request
+   R, which it received through its submit operation.  May be
+   called from an interrupt handler. */
+void
+block_request_done (struct block_request *r)
+{
+  struct block *block = r->block;
+  struct block_queue *q = block->queue;
+  struct list batch;
+  enum intr_level old_level = intr_disable ();
+
+  if (q != NULL && r == q->active)
+    {
+      /* Copy merged reads out of the merge buffer. */
+      if (r == &q->merged && !r->write)
+        {
+          const uint8_t *p = q->merge_buffer;
+          struct list_elem *e;
+
+          for (e = list_begin (&q->batch); e != list_end (&q->batch);
+               e = list_next (e))
+            {
+              struct block_request *b
+                = list_entry (e, struct block_request, elem);
+              memcpy (b->buffer, p, b->cnt * BLOCK_SECTOR_SIZE);
+              p += b->cnt * BLOCK_SECTOR_SIZE;
+            }
+        }
+
+      /* Start the next transfer before completing the requests,
+         since their callbacks may submit more. */
+      list_init (&batch);
+      while (!list_empty (&q->batch))
+        list_push_back (&batch, list_pop_front (&q->batch));
+      q->active = NULL;
+      queue_dispatch (block);
+      while (!list_empty (&batch))
+        complete_request (list_entry (list_pop_front (&batch),
+                                      struct block_request, elem));
+    }
+  else
+    complete_request (r);
+
+  intr_set_level (old_level);
+}
+
+/* Marks R complete and notifies its submitter.  R may be freed
+   as soon as the callback, if any, is called. */
+static void
+complete_request (struct block_request *r)
+{
+  r->complete = true;
+  if (r->callback != NULL)
+    r->callback (r, r->aux);
+  else
+    sema_up (&r->done);
+}
+
+/* Request queue. */
+
+/* Gives BLOCK a request queue.  From then on, requests for BLOCK
+   are sorted and issued to the driver's submit operation one at
+   a time in elevator order, with adjacent requests merged.  Meant
+   for physical disks; partitions pass their requests on to the
+   disk's queue. */
+void
+block_enable_queue (struct block *block)
+{
+  struct block_queue *q;
+
+  ASSERT (block->queue == NULL);
+  ASSERT (block->ops->submit != NULL);
+
+  q = malloc (sizeof *q);
+  if (q == NULL)
+    PANIC ("Failed to allocate memory for block device queue");
+  list_init (&q->requests);
+  list_init (&q->batch);
+  q->active = NULL;
+  q->head = 0;
+  q->merge_buffer = palloc_get_multiple (PAL_ASSERT,
+                                         BLOCK_MERGE_MAX * BLOCK_SECTOR_SIZE
+                                         / PGSIZE);
+  q->merge_cnt = 0;
+  block->queue = q;
+}
+
+/* Returns the request Q should dispatch next: the oldest one if
+   it has passed its deadline, otherwise the first at or after
+   the head position, wrapping around to the lowest sector. */
+static struct block_request *
+pick_request (struct block_queue *q)
+{
+  struct block_request *expired = NULL;
+  struct list_elem *e;
+  int64_t now = timer_ticks ();
+
+  for (e = list_begin (&q->requests); e != list_end (&q->requests);
+       e = list_next (e))
+    {
+      struct block_request *r = list_entry (e, struct block_request, elem);
+      if (r->deadline <= now
+          && (expired == NULL || r->deadline < expired->deadline))
+        expired = r;
+    }
+  if (expired != NULL)
+    return expired;
+
+  for (e = list_begin (&q->requests); e != list_end (&q->requests);
+       e = list_next (e))
+    {
+      struct block_request *r = list_entry (e, struct block_request, elem);
+      if (r->sector >= q->head)
+        return r;
+    }
+  return list_entry (list_front (&q->requests), struct block_request, elem);
+}
+
+/* If BLOCK's driver is idle and requests are pending, takes the
+   next request and the ones that continue it in the same
+   direction and hands them to the driver as one transfer.
+   Interrupts must be off. */
+static void
+queue_dispatch (struct block *block)
+{
+  struct block_queue *q = block->queue;
+  struct block_request *first, *r;
+  struct list_elem *e;
+  size_t cnt;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (q->active != NULL || list_empty (&q->requests))
+    return;
+
+  /* The list is sorted, so the requests right after FIRST on disk
+     follow it in the list. */
+  first = pick_request (q);
+  cnt = first->cnt;
+  e = list_remove (&first->elem);
+  list_push_back (&q->batch, &first->elem);
+  while (e != list_end (&q->requests))
+    {
+      r = list_entry (e, struct block_request, elem);
+      if (r->write != first->write || r->sector != first->sector + cnt
+          || cnt + r->cnt > BLOCK_MERGE_MAX)
+        break;
+      e = list_remove (e);
+      list_push_back (&q->batch, &r->elem);
+      cnt += r->cnt;
+      q->merge_cnt++;
+    }
+  q->head = first->sector + cnt;
+
+  if (cnt == first->cnt)
+    {
+      /* Nothing merged: transfer straight to the caller's buffer. */
+      q->active = first;
+    }
+  else
+    {
+      uint8_t *p = q->merge_buffer;
+
+      if (first->write)
+        for (e = list_begin (&q->batch); e != list_end (&q->batch);
+             e = list_next (e))
+          {
+            r = list_entry (e, struct block_request, elem);
+            memcpy (p, r->buffer, r->cnt * BLOCK_SECTOR_SIZE);
+            p += r->cnt * BLOCK_SECTOR_SIZE;
+          }
+
+      q->active = &q->merged;
+      q->merged.block = block;
+      q->merged.write = first->write;
+      q->merged.sector = first->sector;
+      q->merged.cnt = cnt;
+      q->merged.buffer = q->merge_buffer;
+    }
+  block->ops->submit (block->aux, q->active);
+}
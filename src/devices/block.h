@@ -3,6 +3,8 @@
 
 #include <stddef.h>
 #include <inttypes.h>
+#include <list.h>
+#include "threads/synch.h"
 
 /* Size of a block device sector in bytes.
    All IDE disks use this sector size, as do most USB and SCSI
@@ -53,22 +55,84 @@ struct block *block_next (struct block *);
 block_sector_t block_size (struct block *);
 void block_read (struct block *, block_sector_t, void *);
 void block_write (struct block *, block_sector_t, const void *);
+void block_read_range (struct block *, block_sector_t, size_t cnt, void *);
+void block_write_range (struct block *, block_sector_t, size_t cnt,
+                        const void *);
 const char *block_name (struct block *);
 enum block_type block_type (struct block *);
 
 /* Statistics. */
 void block_print_stats (void);
+
+/* Asynchronous I/O. */
+
+struct block_request;
+typedef void block_callback_func (struct block_request *, void *aux);
+
+/* A read or write submitted with block_submit().  The members
+   belong to the block layer and the driver until the request
+   completes. */
+struct block_request
+  {
+    struct list_elem elem;          /* Element in a request queue. */
+    struct block *block;            /* Device. */
+    bool write;                     /* Write (true) or read (false)? */
+    block_sector_t sector;          /* First sector. */
+    size_t cnt;                     /* Number of sectors. */
+    void *buffer;                   /* Data, in kernel memory. */
+    int64_t deadline;               /* Dispatch by this tick. */
+    block_callback_func *callback;  /* Called on completion, or null. */
+    void *aux;                      /* Passed to CALLBACK. */
+    volatile bool complete;         /* Has the transfer completed? */
+    struct semaphore done;          /* Up'd on completion if no CALLBACK. */
+
+    /* The caller's request, saved while a stacked driver (such as
+       the partition layer) resubmits it to the device below. */
+    struct block *outer_block;
+    block_sector_t outer_sector;
+    block_callback_func *outer_callback;
+    void *outer_aux;
+  };
+
+void block_submit (struct block *, struct block_request *, bool write,
+                   block_sector_t, size_t cnt, void *buffer,
+                   block_callback_func *, void *aux);
+bool block_poll (const struct block_request *);
+void block_wait (struct block_request *);
+void block_request_init_done (struct block_request *);
+
+/* Request queueing. */
+void block_enable_queue (struct block *);
 
 /* Lower-level interface to block device drivers. */
 
 struct block_operations
   {
+    /* Transfer one sector, waiting for completion.  May be null
+       if SUBMIT is provided. */
     void (*read) (void *aux, block_sector_t, void *buffer);
     void (*write) (void *aux, block_sector_t, const void *buffer);
+
+    /* Optional.  Transfer CNT consecutive sectors starting at the
+       given sector as a single request.  If null, the block layer
+       falls back to one read or write per sector. */
+    void (*read_range) (void *aux, block_sector_t, size_t cnt,
+                        void *buffer);
+    void (*write_range) (void *aux, block_sector_t, size_t cnt,
+                         const void *buffer);
+
+    /* Optional.  Starts the transfer described by the request and
+       returns without waiting for it.  The driver calls
+       block_request_done() when the transfer completes, usually
+       from its interrupt handler.  Called with interrupts off.
+       A device with a request queue (see block_enable_queue())
+       has at most one request with its driver at a time. */
+    void (*submit) (void *aux, struct block_request *);
   };
 
 struct block *block_register (const char *name, enum block_type,
                               const char *extra_info, block_sector_t size,
                               const struct block_operations *, void *aux);
+void block_request_done (struct block_request *);
 
 #endif /* devices/block.h */
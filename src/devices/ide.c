@@ -9,6 +9,7 @@
 #include "threads/io.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
+#include "threads/vaddr.h"
 
 /* The code in this file is an interface to an ATA (IDE)
    controller.  It attempts to comply to [ATA-3]. */
@@ -34,6 +35,21 @@
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
 #define STA_DRQ 0x08            /* Data Request. */
+#define STA_ERR 0x01            /* Error. */
+
+/* Bus master IDE port addresses, relative to the channel's
+   bus master base (see find_bus_master()). */
+#define reg_bm_command(CHANNEL) ((CHANNEL)->bm_base + 0)  /* Command. */
+#define reg_bm_status(CHANNEL) ((CHANNEL)->bm_base + 2)   /* Status. */
+#define reg_bm_prdt(CHANNEL) ((CHANNEL)->bm_base + 4)     /* PRD table. */
+
+/* Bus master Command Register bits. */
+#define BM_CMD_START 0x01       /* Start transfer. */
+#define BM_CMD_READ 0x08        /* Transfer from device to memory. */
+
+/* Bus master Status Register bits. */
+#define BM_STA_ERR 0x02         /* Error (write 1 to clear). */
+#define BM_STA_INTR 0x04        /* Interrupt (write 1 to clear). */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -49,6 +65,30 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+#define CMD_READ_MULTIPLE 0xc4          /* READ MULTIPLE. */
+#define CMD_WRITE_MULTIPLE 0xc5         /* WRITE MULTIPLE. */
+#define CMD_SET_MULTIPLE_MODE 0xc6      /* SET MULTIPLE MODE. */
+#define CMD_READ_DMA 0xc8               /* READ DMA. */
+#define CMD_WRITE_DMA 0xca              /* WRITE DMA. */
+
+/* Most sectors a single READ/WRITE command can transfer
+   (a sector count register of 0 means 256). */
+#define MAX_SECTORS_PER_COMMAND 256
+
+/* A bus master Physical Region Descriptor.  Describes one
+   physically contiguous memory region, which may not cross a
+   64 kB boundary, for a DMA transfer. */
+struct prd
+  {
+    uint32_t addr;              /* Physical address. */
+    uint16_t size;              /* Bytes; 0 means 64 kB. */
+    uint16_t flags;             /* PRD_EOT on the last entry. */
+  };
+#define PRD_EOT 0x8000          /* End of table. */
+
+/* A transfer of MAX_SECTORS_PER_COMMAND sectors from a physically
+   contiguous buffer crosses at most two 64 kB boundaries. */
+#define PRD_CNT 4
 
 /* An ATA device. */
 struct ata_disk
@@ -57,6 +97,11 @@ struct ata_disk
     struct channel *channel;    /* Channel that disk is attached to. */
     int dev_no;                 /* Device 0 or 1 for master or slave. */
     bool is_ata;                /* Is device an ATA disk? */
+    int multiple;               /* Sectors per READ/WRITE MULTIPLE block,
+                                   or 0 if unsupported. */
+    bool dma;                   /* Supports READ/WRITE DMA? */
+    struct block_request *pending;  /* Request waiting for the channel,
+                                       or null. */
   };
 
 /* An ATA channel (aka controller).
@@ -67,11 +112,32 @@ struct channel
     uint16_t reg_base;          /* Base I/O port. */
     uint8_t irq;                /* Interrupt in use. */
 
-    struct lock lock;           /* Must acquire to access the controller. */
     bool expecting_interrupt;   /* True if an interrupt is expected, false if
                                    any interrupt would be spurious. */
     struct semaphore completion_wait;   /* Up'd by interrupt handler. */
 
+    /* Request being transferred, advanced by the interrupt
+       handler.  Interrupts must be off to access these. */
+    struct block_request *active;   /* Request, or null if idle. */
+    struct ata_disk *active_disk;   /* Disk that ACTIVE is for. */
+    bool active_dma;            /* Is ACTIVE using DMA? */
+    block_sector_t sec_no;      /* Next sector to transfer. */
+    uint8_t *buffer;            /* Data for sector SEC_NO. */
+    size_t left;                /* Sectors of ACTIVE not yet transferred. */
+    size_t cmd_left;            /* Sectors of the current command not yet
+                                   transferred. */
+    int last_dev;               /* Device of the last request started. */
+
+    /* Statistics. */
+    unsigned long long request_cnt; /* Requests transferred. */
+    int64_t busy_ticks;         /* Ticks spent with a request active. */
+    int64_t busy_since;         /* When the active request started. */
+
+    uint16_t bm_base;           /* Bus master I/O base, or 0 if none. */
+    struct prd prdt[PRD_CNT] __attribute__ ((aligned (sizeof (struct prd) * PRD_CNT)));
+                                /* PRD table; aligned so that it never
+                                   crosses a 64 kB boundary. */
+
     struct ata_disk devices[2];     /* The devices on this channel. */
   };
 
@@ -79,16 +145,30 @@ struct channel
 #define CHANNEL_CNT 2
 static struct channel channels[CHANNEL_CNT];
 
+/* Number of channels with a request active, and the ticks during
+   which both channels were transferring at the same time. */
+static int busy_channel_cnt;
+static int64_t overlap_ticks;
+static int64_t overlap_since;
+
 static struct block_operations ide_operations;
 
 static void reset_channel (struct channel *);
 static bool check_device_type (struct ata_disk *);
 static void identify_ata_device (struct ata_disk *);
+static uint16_t find_bus_master (void);
+static void set_multiple_mode (struct ata_disk *, int sectors);
 
-static void select_sector (struct ata_disk *, block_sector_t);
+static void select_sector (struct ata_disk *, block_sector_t, size_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
+static void start_next_request (struct channel *);
+static void set_channel_busy (struct channel *, bool busy);
+static void start_command (struct channel *);
+static void pio_transfer_block (struct channel *);
+static void transfer_interrupt (struct channel *);
+static bool can_dma (const struct ata_disk *, const void *buffer);
 
 static void wait_until_idle (const struct ata_disk *);
 static bool wait_while_busy (const struct ata_disk *);
@@ -102,6 +182,7 @@ void
 ide_init (void) 
 {
   size_t chan_no;
+  uint16_t bm_base = find_bus_master ();
 
   for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
     {
@@ -123,9 +204,14 @@ ide_init (void)
         default:
           NOT_REACHED ();
         }
-      lock_init (&c->lock);
       c->expecting_interrupt = false;
       sema_init (&c->completion_wait, 0);
+      c->active = NULL;
+      c->last_dev = 1;
+      c->request_cnt = 0;
+      c->busy_ticks = 0;
+      c->busy_since = -1;
+      c->bm_base = bm_base != 0 ? bm_base + chan_no * 8 : 0;
  
       /* Initialize devices. */
       for (dev_no = 0; dev_no < 2; dev_no++)
@@ -136,6 +222,9 @@ ide_init (void)
           d->channel = c;
           d->dev_no = dev_no;
           d->is_ata = false;
+          d->multiple = 0;
+          d->dma = false;
+          d->pending = NULL;
         }
 
       /* Register interrupt handler. */
@@ -155,6 +244,22 @@ ide_init (void)
     }
 }
 
+/* Prints I/O statistics for each channel that has been used. */
+void
+ide_print_stats (void)
+{
+  size_t chan_no;
+
+  for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
+    {
+      struct channel *c = &channels[chan_no];
+      if (c->request_cnt > 0)
+        printf ("%s: %llu requests, busy for %"PRId64" ticks\n",
+                c->name, c->request_cnt, c->busy_ticks);
+    }
+  printf ("ide: both channels busy for %"PRId64" ticks\n", overlap_ticks);
+}
+
 /* Disk detection and identification. */
 
 static char *descramble_ata_string (char *, int size);
@@ -284,6 +389,12 @@ identify_ata_device (struct ata_disk *d)
   /* Calculate capacity.
      Read model name and serial number. */
   capacity = *(uint32_t *) &id[60 * 2];
+
+  /* Word 47 holds the most sectors per READ/WRITE MULTIPLE
+     block, word 49 bit 8 tells whether DMA is supported. */
+  set_multiple_mode (d, (uint8_t) id[47 * 2]);
+  d->dma = c->bm_base != 0 && (*(uint16_t *) &id[49 * 2] & 0x100) != 0;
+
   model = descramble_ata_string (&id[10 * 2], 20);
   serial = descramble_ata_string (&id[27 * 2], 40);
   snprintf (extra_info, sizeof extra_info,
@@ -306,9 +417,94 @@ identify_ata_device (struct ata_disk *d)
   /* Register. */
   block = block_register (d->name, BLOCK_RAW, extra_info, capacity,
                           &ide_operations, d);
+  block_enable_queue (block);
   partition_scan (block);
 }
 
+/* Enables READ/WRITE MULTIPLE on disk D with SECTORS sectors per
+   block.  Leaves D using single-sector PIO commands if SECTORS is
+   not more than 1 or the disk rejects the setting. */
+static void
+set_multiple_mode (struct ata_disk *d, int sectors)
+{
+  struct channel *c = d->channel;
+
+  d->multiple = 0;
+  if (sectors <= 1)
+    return;
+
+  select_device_wait (d);
+  outb (reg_nsect (c), sectors);
+  issue_pio_command (c, CMD_SET_MULTIPLE_MODE);
+  sema_down (&c->completion_wait);
+  wait_while_busy (d);
+  if ((inb (reg_alt_status (c)) & STA_ERR) == 0)
+    d->multiple = sectors;
+}
+
+/* PCI configuration space access, just enough to find the bus
+   master interface of the IDE controller. */
+#define PCI_CONFIG_ADDRESS 0xcf8
+#define PCI_CONFIG_DATA 0xcfc
+
+/* Reads the 32-bit register at offset REG in the configuration
+   space of PCI function FUNC of device DEV on bus BUS. */
+static uint32_t
+pci_read_config (int bus, int dev, int func, int reg)
+{
+  outl (PCI_CONFIG_ADDRESS,
+        0x80000000 | (bus << 16) | (dev << 11) | (func << 8) | (reg & 0xfc));
+  return inl (PCI_CONFIG_DATA);
+}
+
+/* Writes VALUE to the 32-bit register at offset REG in the
+   configuration space of PCI function FUNC of device DEV on bus
+   BUS. */
+static void
+pci_write_config (int bus, int dev, int func, int reg, uint32_t value)
+{
+  outl (PCI_CONFIG_ADDRESS,
+        0x80000000 | (bus << 16) | (dev << 11) | (func << 8) | (reg & 0xfc));
+  outl (PCI_CONFIG_DATA, value);
+}
+
+/* Looks on PCI bus 0 for an IDE controller that supports bus
+   mastering, enables bus mastering on it, and returns the I/O
+   base of its bus master registers (the primary channel's; the
+   secondary channel's follow 8 bytes later).  Returns 0 if there
+   is no such controller, in which case all transfers use PIO. */
+static uint16_t
+find_bus_master (void)
+{
+  int dev, func;
+
+  for (dev = 0; dev < 32; dev++)
+    for (func = 0; func < 8; func++)
+      {
+        uint32_t id = pci_read_config (0, dev, func, 0x00);
+        uint32_t class, bar4;
+
+        if ((id & 0xffff) == 0xffff)
+          continue;
+
+        /* Class 1 (mass storage), subclass 1 (IDE), with the
+           bus master bit set in the programming interface. */
+        class = pci_read_config (0, dev, func, 0x08);
+        if ((class >> 16) != 0x0101 || (class & 0x8000) == 0)
+          continue;
+
+        bar4 = pci_read_config (0, dev, func, 0x20);
+        if ((bar4 & 1) == 0 || (bar4 & 0xfffc) == 0)
+          continue;
+
+        /* Enable I/O space and bus master. */
+        pci_write_config (0, dev, func, 0x04,
+                          pci_read_config (0, dev, func, 0x04) | 0x5);
+        return bar4 & 0xfffc;
+      }
+  return 0;
+}
+
 /* Translates STRING, which consists of SIZE bytes in a funky
    format, into a null-terminated string in-place.  Drops
    trailing whitespace and null bytes.  Returns STRING.  */
@@ -337,63 +533,245 @@ descramble_ata_string (char *string, int size)
   return string;
 }
 
-/* Reads sector SEC_NO from disk D into BUFFER, which must have
-   room for BLOCK_SECTOR_SIZE bytes.
-   Internally synchronizes accesses to disks, so external
-   per-disk locking is unneeded. */
+/* Starts transferring request R for disk D, or queues it until
+   D's channel is free.  Each group of up to
+   MAX_SECTORS_PER_COMMAND sectors is transferred with a single
+   command: READ/WRITE DMA if the disk and buffer allow it,
+   otherwise a PIO READ/WRITE MULTIPLE or READ/WRITE SECTOR.  The
+   interrupt handler carries the transfer on and calls
+   block_request_done() at the end.  Interrupts must be off. */
 static void
-ide_read (void *d_, block_sector_t sec_no, void *buffer)
+ide_submit (void *d_, struct block_request *r)
 {
   struct ata_disk *d = d_;
-  struct channel *c = d->channel;
-  lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-  sema_down (&c->completion_wait);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-  input_sector (c, buffer);
-  lock_release (&c->lock);
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (d->pending == NULL);
+
+  d->pending = r;
+  if (d->channel->active == NULL)
+    start_next_request (d->channel);
 }
 
-/* Write sector SEC_NO to disk D from BUFFER, which must contain
-   BLOCK_SECTOR_SIZE bytes.  Returns after the disk has
-   acknowledged receiving the data.
-   Internally synchronizes accesses to disks, so external
-   per-disk locking is unneeded. */
+static struct block_operations ide_operations =
+  {
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    ide_submit
+  };
+
+/* If channel C is idle, starts the request pending for one of
+   its disks, alternating between the disks when both have
+   one. */
 static void
-ide_write (void *d_, block_sector_t sec_no, const void *buffer)
+start_next_request (struct channel *c)
 {
-  struct ata_disk *d = d_;
-  struct channel *c = d->channel;
-  lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
+  struct ata_disk *d = &c->devices[!c->last_dev];
+
+  ASSERT (c->active == NULL);
+
+  if (d->pending == NULL)
+    d = &c->devices[c->last_dev];
+  if (d->pending == NULL)
+    {
+      set_channel_busy (c, false);
+      return;
+    }
+  set_channel_busy (c, true);
+
+  c->active = d->pending;
+  c->active_disk = d;
+  c->active_dma = can_dma (d, c->active->buffer);
+  c->sec_no = c->active->sector;
+  c->buffer = c->active->buffer;
+  c->left = c->active->cnt;
+  c->last_dev = d->dev_no;
+  c->request_cnt++;
+  d->pending = NULL;
+  start_command (c);
+}
+
+/* Records channel C becoming BUSY or idle, for the statistics.
+   Does nothing if it already was. */
+static void
+set_channel_busy (struct channel *c, bool busy)
+{
+  int64_t now;
+
+  if (busy == (c->busy_since != -1))
+    return;
+
+  now = timer_ticks ();
+  if (busy)
+    {
+      c->busy_since = now;
+      if (++busy_channel_cnt == CHANNEL_CNT)
+        overlap_since = now;
+    }
+  else
+    {
+      c->busy_ticks += now - c->busy_since;
+      c->busy_since = -1;
+      if (busy_channel_cnt-- == CHANNEL_CNT)
+        overlap_ticks += now - overlap_since;
+    }
+}
+
+/* Issues the command for the next group of sectors of channel
+   C's active request. */
+static void
+start_command (struct channel *c)
+{
+  struct ata_disk *d = c->active_disk;
+  bool write = c->active->write;
+  size_t cnt = c->left < MAX_SECTORS_PER_COMMAND ? c->left : MAX_SECTORS_PER_COMMAND;
+
+  c->cmd_left = cnt;
+  if (c->active_dma)
+    {
+      uintptr_t paddr = vtop (c->buffer);
+      size_t bytes = cnt * BLOCK_SECTOR_SIZE;
+      size_t prd_cnt = 0;
+
+      /* Describe the buffer, splitting it at 64 kB boundaries. */
+      while (bytes > 0)
+        {
+          size_t chunk = 0x10000 - (paddr & 0xffff);
+          if (chunk > bytes)
+            chunk = bytes;
+
+          ASSERT (prd_cnt < PRD_CNT);
+          c->prdt[prd_cnt].addr = paddr;
+          c->prdt[prd_cnt].size = chunk & 0xffff;
+          c->prdt[prd_cnt].flags = 0;
+          prd_cnt++;
+
+          paddr += chunk;
+          bytes -= chunk;
+        }
+      c->prdt[prd_cnt - 1].flags = PRD_EOT;
+
+      /* Program the bus master, then the disk, then start. */
+      outb (reg_bm_command (c), 0);
+      outl (reg_bm_prdt (c), vtop (c->prdt));
+      outb (reg_bm_status (c),
+            inb (reg_bm_status (c)) | BM_STA_ERR | BM_STA_INTR);
+      select_sector (d, c->sec_no, cnt);
+      issue_pio_command (c, write ? CMD_WRITE_DMA : CMD_READ_DMA);
+      outb (reg_bm_command (c), BM_CMD_START | (write ? 0 : BM_CMD_READ));
+    }
+  else
+    {
+      /* With READ/WRITE MULTIPLE the disk interrupts once per
+         block of D->multiple sectors, otherwise once per
+         sector. */
+      bool multiple = d->multiple > 1;
+
+      select_sector (d, c->sec_no, cnt);
+      if (write)
+        {
+          issue_pio_command (c, multiple ? CMD_WRITE_MULTIPLE
+                                         : CMD_WRITE_SECTOR_RETRY);
+          pio_transfer_block (c);
+        }
+      else
+        issue_pio_command (c, multiple ? CMD_READ_MULTIPLE
+                                       : CMD_READ_SECTOR_RETRY);
+    }
+}
+
+/* Moves the next block of sectors of channel C's active PIO
+   request between the data register and memory, once the disk
+   is ready for it. */
+static void
+pio_transfer_block (struct channel *c)
+{
+  struct ata_disk *d = c->active_disk;
+  size_t block = d->multiple > 1 ? d->multiple : 1;
+  size_t i;
+
   if (!wait_while_busy (d))
-    PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-  output_sector (c, buffer);
-  sema_down (&c->completion_wait);
-  lock_release (&c->lock);
+    PANIC ("%s: disk %s failed, sector=%"PRDSNu, d->name,
+           c->active->write ? "write" : "read", c->sec_no);
+  for (i = 0; i < block && c->cmd_left > 0; i++)
+    {
+      if (c->active->write)
+        output_sector (c, c->buffer);
+      else
+        input_sector (c, c->buffer);
+      c->buffer += BLOCK_SECTOR_SIZE;
+      c->sec_no++;
+      c->left--;
+      c->cmd_left--;
+    }
+}
+
+/* Handles a completion interrupt for channel C's active
+   request: moves data for PIO, checks the bus master for DMA,
+   and then continues with the next block, the next command, or
+   the next request. */
+static void
+transfer_interrupt (struct channel *c)
+{
+  struct ata_disk *d = c->active_disk;
+  struct block_request *r = c->active;
+
+  if (c->active_dma)
+    {
+      uint8_t bm_status = inb (reg_bm_status (c));
+      outb (reg_bm_command (c), 0);
+      outb (reg_bm_status (c), bm_status | BM_STA_ERR | BM_STA_INTR);
+      if ((bm_status & BM_STA_ERR) != 0
+          || (inb (reg_alt_status (c)) & STA_ERR) != 0)
+        PANIC ("%s: DMA %s failed, sector=%"PRDSNu, d->name,
+               r->write ? "write" : "read", c->sec_no);
+      c->buffer += c->cmd_left * BLOCK_SECTOR_SIZE;
+      c->sec_no += c->cmd_left;
+      c->left -= c->cmd_left;
+      c->cmd_left = 0;
+    }
+  else if (r->write)
+    {
+      /* The disk took the last block; send it the next one. */
+      if (c->cmd_left > 0)
+        {
+          pio_transfer_block (c);
+          return;
+        }
+    }
+  else
+    pio_transfer_block (c);
+
+  if (c->cmd_left > 0)
+    return;
+  if (c->left > 0)
+    {
+      start_command (c);
+      return;
+    }
+
+  /* Done.  Start the other disk's request, if any, before
+     completing this one, since completion may submit another. */
+  c->active = NULL;
+  start_next_request (c);
+  block_request_done (r);
 }
 
-static struct block_operations ide_operations =
-  {
-    ide_read,
-    ide_write
-  };
-
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and the sector count CNT to the disk's sector
+   selection registers.  (We use LBA mode.) */
 static void
-select_sector (struct ata_disk *d, block_sector_t sec_no)
+select_sector (struct ata_disk *d, block_sector_t sec_no, size_t cnt)
 {
   struct channel *c = d->channel;
 
   ASSERT (sec_no < (1UL << 28));
+  ASSERT (cnt > 0 && cnt <= MAX_SECTORS_PER_COMMAND);
   
   select_device_wait (d);
-  outb (reg_nsect (c), 1);
+  outb (reg_nsect (c), cnt == MAX_SECTORS_PER_COMMAND ? 0 : cnt);
   outb (reg_lbal (c), sec_no);
   outb (reg_lbam (c), sec_no >> 8);
   outb (reg_lbah (c), (sec_no >> 16));
@@ -406,14 +784,20 @@ select_sector (struct ata_disk *d, block_sector_t sec_no)
 static void
 issue_pio_command (struct channel *c, uint8_t command) 
 {
-  /* Interrupts must be enabled or our semaphore will never be
-     up'd by the completion handler. */
-  ASSERT (intr_get_level () == INTR_ON);
-
   c->expecting_interrupt = true;
   outb (reg_command (c), command);
 }
 
+/* Returns true if a transfer to or from BUFFER on disk D can use
+   DMA.  The buffer must be in kernel virtual memory, which maps
+   physical memory linearly, so that it is physically contiguous;
+   user buffers go through PIO. */
+static bool
+can_dma (const struct ata_disk *d, const void *buffer)
+{
+  return d->dma && is_kernel_vaddr (buffer) && ((uintptr_t) buffer & 1) == 0;
+}
+
 /* Reads a sector from channel C's data register in PIO mode into
    SECTOR, which must have room for BLOCK_SECTOR_SIZE bytes. */
 static void
@@ -446,7 +830,7 @@ wait_until_idle (const struct ata_disk *d)
     {
       if ((inb (reg_status (d->channel)) & (STA_BSY | STA_DRQ)) == 0)
         return;
-      timer_usleep (10);
+      timer_udelay (10);
     }
 
   printf ("%s: idle timeout\n", d->name);
@@ -455,7 +839,8 @@ wait_until_idle (const struct ata_disk *d)
 /* Wait up to 30 seconds for disk D to clear BSY,
    and then return the status of the DRQ bit.
    The ATA standards say that a disk may take as long as that to
-   complete its reset. */
+   complete its reset.  Busy-waits if interrupts are off, as they
+   are when a transfer is advanced by the interrupt handler. */
 static bool
 wait_while_busy (const struct ata_disk *d) 
 {
@@ -472,7 +857,10 @@ wait_while_busy (const struct ata_disk *d)
             printf ("ok\n");
           return (inb (reg_alt_status (c)) & STA_DRQ) != 0;
         }
-      timer_msleep (10);
+      if (intr_get_level () == INTR_ON)
+        timer_msleep (10);
+      else
+        timer_mdelay (10);
     }
 
   printf ("failed\n");
@@ -489,7 +877,7 @@ select_device (const struct ata_disk *d)
     dev |= DEV_DEV;
   outb (reg_device (c), dev);
   inb (reg_alt_status (c));
-  timer_nsleep (400);
+  timer_ndelay (400);
 }
 
 /* Select disk D in its channel, as select_device(), but wait for
@@ -514,7 +902,10 @@ interrupt_handler (struct intr_frame *f)
         if (c->expecting_interrupt) 
           {
             inb (reg_status (c));               /* Acknowledge interrupt. */
-            sema_up (&c->completion_wait);      /* Wake up waiter. */
+            if (c->active != NULL)
+              transfer_interrupt (c);           /* Continue transfer. */
+            else
+              sema_up (&c->completion_wait);    /* Wake up waiter. */
           }
         else
           printf ("%s: unexpected interrupt\n", c->name);
@@ -317,8 +317,61 @@ partition_write (void *p_, block_sector_t sector, const void *buffer)
   block_write (p->block, p->start + sector, buffer);
 }
 
+/* Reads CNT sectors starting at SECTOR from partition P into
+   BUFFER as one request to the underlying device. */
+static void
+partition_read_range (void *p_, block_sector_t sector, size_t cnt,
+                      void *buffer)
+{
+  struct partition *p = p_;
+  block_read_range (p->block, p->start + sector, cnt, buffer);
+}
+
+/* Writes CNT sectors starting at SECTOR to partition P from
+   BUFFER as one request to the underlying device. */
+static void
+partition_write_range (void *p_, block_sector_t sector, size_t cnt,
+                       const void *buffer)
+{
+  struct partition *p = p_;
+  block_write_range (p->block, p->start + sector, cnt, buffer);
+}
+
+/* Called when the underlying device finishes request R.
+   Restores the caller's view of R, which names the partition
+   and a partition-relative sector, and then completes it. */
+static void
+partition_complete (struct block_request *r, void *aux UNUSED)
+{
+  r->block = r->outer_block;
+  r->sector = r->outer_sector;
+  r->callback = r->outer_callback;
+  r->aux = r->outer_aux;
+  block_request_done (r);
+}
+
+/* Passes request R on to partition P's underlying device,
+   without waiting for it.  R's block and sector are rewritten
+   for the device below until partition_complete() puts them
+   back. */
+static void
+partition_submit (void *p_, struct block_request *r)
+{
+  struct partition *p = p_;
+
+  r->outer_block = r->block;
+  r->outer_sector = r->sector;
+  r->outer_callback = r->callback;
+  r->outer_aux = r->aux;
+  block_submit (p->block, r, r->write, p->start + r->sector, r->cnt,
+                r->buffer, partition_complete, NULL);
+}
+
 static struct block_operations partition_operations =
   {
     partition_read,
-    partition_write
+    partition_write,
+    partition_read_range,
+    partition_write_range,
+    partition_submit
   };
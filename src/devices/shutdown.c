@@ -11,7 +11,12 @@
 #endif
 #ifdef FILESYS
 #include "devices/block.h"
+#include "devices/ide.h"
 #include "filesys/filesys.h"
+#include "filesys/cache.h"
+#endif
+#ifdef VM
+#include "vm/zswap.h"
 #endif
 
 /* Keyboard control register port. */
@@ -132,6 +137,11 @@ print_stats (void)
   thread_print_stats ();
 #ifdef FILESYS
   block_print_stats ();
+  ide_print_stats ();
+  buffer_cache_print_stats ();
+#endif
+#ifdef VM
+  vm_zswap_print_stats ();
 #endif
   console_print_stats ();
   kbd_print_stats ();
@@ -2,45 +2,277 @@
 #include "filesys/filesys.h"
 #include "threads/synch.h"
 #include <string.h>
+#include <stdio.h>
 #include <debug.h>
 #include "threads/vaddr.h"
+#include <hash.h>
+#include <list.h>
+#include <stdlib.h>
+#include <round.h>
+#include <cache-stats.h>
+#include "threads/thread.h"
+#include "threads/palloc.h"
+#include "threads/loader.h"
+#include "devices/timer.h"
 
 struct buffer_cache_entry {
   bool valid_bit;                    // true if valid cache entry
   bool reference_bit;                // for clock algorithm
   bool dirty;
+  bool prefetched;                   // read-ahead로 읽은 뒤 아직 참조되지 않았다.
 
   block_sector_t disk_sector;
-  uint8_t buffer[BLOCK_SECTOR_SIZE]; // 512 * 1B
+  uint8_t* buffer;                   // cache_data 안의 BLOCK_SECTOR_SIZE bytes
+
+  struct hash_elem index_elem;       // valid entry이면 buffer_cache_index에 존재한다.
+  struct list_elem free_elem;        // invalid entry이면 buffer_cache_free_slots에 존재한다.
+
+  /* replacement policy가 사용한다(buffer_cache_lock으로 보호). */
+  struct list_elem policy_elem;      // 2Q: valid entry이면 A1in 또는 Am에 존재한다.
+  bool hot;                          // 2Q: Am에 있다면 true, A1in에 있다면 false
+
+  /* 이 entry를 사용중인 스레드의 수(buffer_cache_lock으로 보호).
+     0보다 크면 evict되거나 다른 sector로 바뀌지 않는다. */
+  int pin_cnt;
+
+  /* buffer, dirty를 보호한다.
+     pin_cnt를 올린 스레드만 이 lock을 잡을 수 있다. 따라서 pin_cnt == 0 이라면
+     아무도 이 lock을 잡고 있지 않다. */
+  struct lock lock;
+};
+
+/* cache의 크기(sector 개수). -cache=N 옵션으로 정할 수 있고, 정하지 않으면
+   RAM의 1/BUFFER_CACHE_RAM_FRACTION 만큼을 쓰되 BUFFER_CACHE_DEFAULT_MIN보다 작지 않게 한다. */
+#define BUFFER_CACHE_MIN 16
+#define BUFFER_CACHE_DEFAULT_MIN 64
+#define BUFFER_CACHE_RAM_FRACTION 64
+
+/* buffer_cache_read_sectors()는 cache의 1/BUFFER_CACHE_BYPASS_FRACTION보다 많은 sector를
+   한 번에 읽을 때만 cache에 없는 sector들을 cache를 거치지 않고 읽는다. */
+#define BUFFER_CACHE_BYPASS_FRACTION 4
+
+/* 교체 정책. 모든 함수는 buffer_cache_lock을 잡은 채로 호출된다.
+   -cache-policy=NAME 옵션으로 고를 수 있다. */
+struct buffer_cache_policy {
+  const char *name;
+  void (*init) (void);
+  /* cache hit. */
+  void (*touch) (struct buffer_cache_entry *entry);
+  /* entry가 새 sector를 나타내게 되었다. prefetch인 경우 referenced는 false이다. */
+  void (*insert) (struct buffer_cache_entry *entry, bool referenced);
+  /* entry가 evict되어 더 이상 disk_sector를 나타내지 않는다. */
+  void (*remove) (struct buffer_cache_entry *entry);
+  /* pin되지 않은 entry 중에 evict할 것을 고른다. clean entry를 먼저 고르며, 없다면 null. */
+  struct buffer_cache_entry *(*select_victim) (void);
 };
 
-#define NUM_CACHE 64
+/* Buffer cache. buffer_cache_init()에서 palloc으로 할당한다.
+   cache[i]의 데이터는 cache_data + i * BLOCK_SECTOR_SIZE에 있다. */
+static struct buffer_cache_entry* cache;
+static uint8_t* cache_data;
+static size_t cache_cnt;
+
+/* -cache=N 옵션으로 정한 크기. 0이면 RAM 크기에 맞춰 정한다. */
+static size_t cache_cnt_option;
+
+/* buffer_cache_flush_all()에서 dirty sector들을 모아 정렬하는 배열과
+   sector가 연속된 entry들을 한 번에 기록하기 위해 모아두는 buffer.
+   flush_buffer의 FLUSH_BUFFER_SECTORS개 sector를 다 쓸 때까지 기록 요청들을
+   기다리지 않고 block_submit()으로 연달아 보내며, 요청마다 flush_requests를 하나씩 쓴다.
+   flush_lock으로 보호한다. */
+#define FLUSH_RUN_MAX 32
+#define FLUSH_BUFFER_SECTORS 64
+static block_sector_t* flush_list;
+static uint8_t* flush_buffer;
+static struct block_request flush_requests[FLUSH_BUFFER_SECTORS];
+static struct lock flush_lock;
+
+/* flush_requests[i]로 보낸 run의 fs_device 기준 첫 sector와 sector 수.
+   request의 sector와 block은 partition 아래의 device가 쓰는 값일 수 있으므로
+   flusher가 보낸 값을 따로 기억해둔다. */
+struct flush_run{
+  block_sector_t start;
+  size_t cnt;
+};
+static struct flush_run flush_runs[FLUSH_BUFFER_SECTORS];
+
+/* flush_requests 중 앞의 flush_pending_cnt개는 보냈지만 끝났는지 아직 확인하지 않은 요청이다.
+   entry는 flush_buffer로 복사한 뒤 곧바로 unpin되므로 기록이 끝나기 전에 evict될 수 있다.
+   그런 sector를 disk에서 읽거나 다시 기록하려는 스레드는 buffer_cache_flushed에서 기다린다.
+   (block queue는 먼저 보낸 요청을 먼저 처리한다고 보장하지 않는다.)
+   buffer_cache_lock으로 보호한다. */
+static size_t flush_pending_cnt;
+static struct condition buffer_cache_flushed;
+
+/* sector -> slot 색인. valid entry만 들어있다.
+   (key, value) = (disk_sector, buffer_cache_entry) */
+static struct hash buffer_cache_index;
 
-/* Buffer cache */
-static struct buffer_cache_entry cache[NUM_CACHE];
+/* 아직 sector가 할당되지 않은 slot들. */
+static struct list buffer_cache_free_slots;
 
-/* 모두 writers 함수로 봐도 무방 */
+/* buffer_cache_index, buffer_cache_free_slots, clock과
+   각 entry의 valid_bit, reference_bit, disk_sector, pin_cnt를 보호한다.
+   잠깐 동안만 잡으며, 이 lock을 잡은 채로 block_read(), block_write()를 하지 않는다.
+
+   lock 순서: entry->lock -> buffer_cache_lock
+   (예외: pin_cnt == 0 인 entry의 lock은 경쟁자가 없으므로 buffer_cache_lock을 잡은 채로 잡을 수 있다.) */
 struct lock buffer_cache_lock;
 
+/* 모든 entry가 pin된 상태에서 allocate 하려는 스레드가 기다린다. */
+static struct condition buffer_cache_unpinned;
+
+/* write-behind: flusher 스레드가 이 주기(ticks)마다 dirty entry들을 disk에 기록한다.
+   evict할 때 동기적으로 block_write() 해야하는 일을 줄이고,
+   crash가 나도 잃어버리는 데이터를 이 주기 만큼으로 제한한다. */
+#define BUFFER_CACHE_FLUSH_INTERVAL (TIMER_FREQ)
+
+/* buffer_cache_terminate() 이후에는 flusher가 멈춘다. */
+static bool buffer_cache_terminating;
+
+/* read-ahead 요청 큐(circular queue).
+   inode_read_at()이 다음에 읽을 sector들을 넣어두면 read-ahead 스레드가 미리 cache에 올려둔다.
+   가득 찬 경우에는 요청을 버린다(미리 읽는 것은 최적화일 뿐이다).
+   read-ahead 스레드는 한 번에 READ_AHEAD_BATCH개까지 꺼내 읽기 요청을 동시에 보낸다. */
+#define READ_AHEAD_QUEUE_SIZE 64
+#define READ_AHEAD_BATCH 8
+static block_sector_t read_ahead_queue[READ_AHEAD_QUEUE_SIZE];
+static int read_ahead_head, read_ahead_cnt;
+static struct lock read_ahead_lock;
+static struct semaphore read_ahead_items;   /* 큐에 있는 요청의 개수 */
+
+/* 통계(buffer_cache_lock으로 보호). hits, misses에는 read-ahead를 세지 않는다. */
+static struct cache_stats stats;
+
+static void clock_init (void);
+static void clock_touch (struct buffer_cache_entry *entry);
+static void clock_insert (struct buffer_cache_entry *entry, bool referenced);
+static void clock_remove (struct buffer_cache_entry *entry);
+static struct buffer_cache_entry* clock_select_victim (void);
+
+static void two_q_init (void);
+static void two_q_touch (struct buffer_cache_entry *entry);
+static void two_q_insert (struct buffer_cache_entry *entry, bool referenced);
+static void two_q_remove (struct buffer_cache_entry *entry);
+static struct buffer_cache_entry* two_q_select_victim (void);
+
+static const struct buffer_cache_policy clock_policy =
+  {"clock", clock_init, clock_touch, clock_insert, clock_remove, clock_select_victim};
+static const struct buffer_cache_policy two_q_policy =
+  {"2q", two_q_init, two_q_touch, two_q_insert, two_q_remove, two_q_select_victim};
+
+static const struct buffer_cache_policy *policies[] = {&clock_policy, &two_q_policy};
+
+/* 사용중인 교체 정책. */
+static const struct buffer_cache_policy *policy = &clock_policy;
+
 static struct buffer_cache_entry* buffer_cache_lookup (block_sector_t sector);
 static void buffer_cache_flush_entry(struct buffer_cache_entry* entry);
-static struct buffer_cache_entry* buffer_cache_select_victim ();
-static struct buffer_cache_entry* buffer_cache_allocate();
-static void buffer_cache_flush_all();
+static struct buffer_cache_entry* buffer_cache_allocate(block_sector_t sector, bool referenced, bool may_wait);
+static void buffer_cache_flush_all(void);
+static void buffer_cache_flush_wait(size_t request_cnt);
+static bool buffer_cache_flush_pending(block_sector_t sector, size_t cnt);
+static void buffer_cache_wait_for_flush(block_sector_t sector, size_t cnt);
+static void buffer_cache_flusher (void *aux);
+static void buffer_cache_read_aheader (void *aux);
+static struct buffer_cache_entry* buffer_cache_prefetch (block_sector_t sector, bool may_wait, struct block_request* request);
+static int buffer_cache_sector_compare (const void *a, const void *b);
+static void* buffer_cache_alloc_array (size_t size);
+
+static struct buffer_cache_entry* buffer_cache_acquire (block_sector_t sector, bool need_read);
+static struct buffer_cache_entry* buffer_cache_data_to_entry (void *data);
+static void buffer_cache_release (struct buffer_cache_entry* slot);
+static void buffer_cache_unpin (struct buffer_cache_entry* slot);
+static void buffer_cache_lock_global (void);
+static void buffer_cache_lock_entry (struct buffer_cache_entry* slot);
+
+static unsigned buffer_cache_hash_func (const struct hash_elem *e, void *aux);
+static bool buffer_cache_less_func (const struct hash_elem *a, const struct hash_elem *b, void *aux);
+
+
+/* 교체 정책을 NAME으로 바꾼다. buffer_cache_init() 전에 호출해야 한다.
+   NAME에 해당하는 정책이 없다면 false를 반환한다. */
+bool buffer_cache_set_policy (const char *name){
+  for (size_t i = 0; i < sizeof policies / sizeof *policies; ++i){
+    if (!strcmp (policies[i]->name, name)){
+      policy = policies[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+
+/* cache의 크기를 CNT개의 sector로 정한다. buffer_cache_init() 전에 호출해야 한다.
+   CNT가 너무 작다면 false를 반환한다. */
+bool buffer_cache_set_size (int cnt){
+  if (cnt < BUFFER_CACHE_MIN)
+    return false;
+  cache_cnt_option = cnt;
+  return true;
+}
 
 
 void buffer_cache_init (void){
   lock_init (&buffer_cache_lock);
+  cond_init (&buffer_cache_unpinned);
+  cond_init (&buffer_cache_flushed);
+  flush_pending_cnt = 0;
+  hash_init (&buffer_cache_index, buffer_cache_hash_func, buffer_cache_less_func, NULL);
+  list_init (&buffer_cache_free_slots);
+
+  cache_cnt = cache_cnt_option;
+  if (cache_cnt == 0){
+    cache_cnt = (size_t) init_ram_pages * (PGSIZE / BLOCK_SECTOR_SIZE) / BUFFER_CACHE_RAM_FRACTION;
+    if (cache_cnt < BUFFER_CACHE_DEFAULT_MIN)
+      cache_cnt = BUFFER_CACHE_DEFAULT_MIN;
+  }
+  cache = buffer_cache_alloc_array (cache_cnt * sizeof *cache);
+  cache_data = buffer_cache_alloc_array (cache_cnt * BLOCK_SECTOR_SIZE);
+  flush_list = buffer_cache_alloc_array (cache_cnt * sizeof *flush_list);
+  flush_buffer = buffer_cache_alloc_array (FLUSH_BUFFER_SECTORS * BLOCK_SECTOR_SIZE);
+  lock_init (&flush_lock);
 
-  for (int i = 0; i < NUM_CACHE; ++ i)
+  for (size_t i = 0; i < cache_cnt; ++ i){
     cache[i].valid_bit = false;
+    cache[i].buffer = cache_data + i * BLOCK_SECTOR_SIZE;
+    cache[i].pin_cnt = 0;
+    lock_init (&cache[i].lock);
+    list_push_back (&buffer_cache_free_slots, &cache[i].free_elem);
+  }
+  policy->init ();
+  memset (&stats, 0, sizeof stats);
+
+  buffer_cache_terminating = false;
+  thread_create ("cache-flusher", PRI_DEFAULT, buffer_cache_flusher, NULL);
+
+  read_ahead_head = read_ahead_cnt = 0;
+  lock_init (&read_ahead_lock);
+  sema_init (&read_ahead_items, 0);
+  thread_create ("cache-readahead", PRI_DEFAULT, buffer_cache_read_aheader, NULL);
 }
 
 void buffer_cache_terminate (void){
-  lock_acquire(&buffer_cache_lock);
-
+  buffer_cache_terminating = true;
   buffer_cache_flush_all();
+}
 
+
+/* Prints buffer cache statistics. */
+void buffer_cache_print_stats (void){
+  printf ("Buffer cache (%s, %zu sectors): %llu hits, %llu misses, "
+          "%llu evictions, %llu writebacks\n",
+          policy->name, cache_cnt, stats.hits, stats.misses,
+          stats.evictions, stats.writebacks);
+  printf ("Buffer cache: %llu read-aheads, %llu read-ahead hits, %llu lock waits\n",
+          stats.read_aheads, stats.read_ahead_hits, stats.lock_waits);
+}
+
+
+/* 지금까지의 통계를 *DST에 복사한다. */
+void buffer_cache_get_stats (struct cache_stats *dst){
+  buffer_cache_lock_global();
+  *dst = stats;
   lock_release(&buffer_cache_lock);
 }
 
@@ -49,20 +281,11 @@ void buffer_cache_terminate (void){
    @param sector_ofs: sector에 있는 값을 읽어들일때 시작점
    @param chunk_size: 실제로 이 sector에서 읽어들일 bytes */
 void buffer_cache_read (block_sector_t sector, void *buffer, int sector_ofs, int chunk_size){
-  lock_acquire(&buffer_cache_lock);
-  struct buffer_cache_entry* slot = buffer_cache_lookup(sector);
-  if(slot == NULL){
-    slot = buffer_cache_allocate();
-    slot->valid_bit = true;
-    slot->dirty = false;
-    slot->disk_sector = sector;
-    block_read(fs_device, sector, slot->buffer);
-  }
+  struct buffer_cache_entry* slot = buffer_cache_acquire(sector, true);
 
-  slot->reference_bit = true;
   memcpy(buffer, slot->buffer + sector_ofs, chunk_size);
 
-  lock_release(&buffer_cache_lock);
+  buffer_cache_release(slot);
 }
 
 
@@ -70,87 +293,680 @@ void buffer_cache_read (block_sector_t sector, void *buffer, int sector_ofs, int
    @param sector_ofs: sector에 적는 시작점
    @param chunk_size: 실제로 이 sector에 적을 bytes  */
 void buffer_cache_write (block_sector_t sector, void *buffer, int sector_ofs, int chunk_size){
-  lock_acquire(&buffer_cache_lock);
-  struct buffer_cache_entry* slot = buffer_cache_lookup(sector);
-  
-  if(slot == NULL){
-    slot = buffer_cache_allocate();
-    slot->valid_bit = true;
-    slot->dirty = false;
-    slot->disk_sector = sector;
-    block_read(fs_device, sector, slot->buffer);
-  }
+  /* sector 전체를 덮어쓰는 경우에는 disk에서 미리 읽어올 필요가 없다. */
+  struct buffer_cache_entry* slot = buffer_cache_acquire(sector, chunk_size != BLOCK_SECTOR_SIZE);
 
-  slot->reference_bit = true;
   slot->dirty = true;
   memcpy(slot->buffer + sector_ofs, buffer, chunk_size);
 
-  lock_release(&buffer_cache_lock);
+  buffer_cache_release(slot);
 }
 
 
-/* buffer cache 중에 sector와 일치하는 entry를 반환한다.
-   없다면 null을 반환한다. */
-static struct buffer_cache_entry* buffer_cache_lookup (block_sector_t sector){
-  for(int i = 0; i < NUM_CACHE; ++i){
-    if(cache[i].valid_bit && cache[i].disk_sector == sector)
-      return &(cache[i]);
+/* SECTOR부터 연속된 CNT개의 sector 전체를 BUFFER로 읽는다.
+   CNT가 cache의 1/BUFFER_CACHE_BYPASS_FRACTION 이하라면 다시 읽힐 수 있으므로 모두 cache를 거친다.
+   그보다 크다면 cache에 있는 sector는 cache에서 복사하고, cache에 없는 sector가 둘 이상 연속되면
+   cache를 거치지 않고 한 번의 block_read_range()로 BUFFER에 바로 읽는다.
+   따라서 큰 파일을 한 번 읽어도 cache에 있던 sector들이 밀려나지 않는다.
+
+   dirty entry는 disk에 기록될 때까지 색인에 남아있으므로, cache에 없는 sector는
+   disk의 내용이 최신이다.
+
+   block device의 request queue는 kernel 주소만 받으므로, BUFFER가 user 주소라면
+   한 page짜리 bounce buffer로 읽은 뒤 복사한다. */
+void buffer_cache_read_sectors (block_sector_t sector, size_t cnt, void *buffer_){
+  uint8_t* buffer = buffer_;
+  uint8_t* bounce = NULL;
+  size_t run_max = cnt;
+  size_t i = 0;
+
+  if(cnt <= cache_cnt / BUFFER_CACHE_BYPASS_FRACTION){
+    for(; i < cnt; i++)
+      buffer_cache_read(sector + i, buffer + i * BLOCK_SECTOR_SIZE, 0, BLOCK_SECTOR_SIZE);
+    return;
   }
-  return NULL;
+
+  if(!is_kernel_vaddr(buffer)){
+    bounce = palloc_get_page(0);
+    run_max = bounce != NULL ? PGSIZE / BLOCK_SECTOR_SIZE : 1;
+  }
+
+  while(i < cnt){
+    size_t run = 0;
+
+    buffer_cache_lock_global();
+    while(true){
+      run = 0;
+      while(i + run < cnt && run < run_max && buffer_cache_lookup(sector + i + run) == NULL)
+        run++;
+      /* 기록중인 sector라면 끝나기를 기다린 뒤 다시 찾아본다. 기다리는 동안 cache에 올라왔을 수 있다. */
+      if(run < 2 || !buffer_cache_flush_pending(sector + i, run))
+        break;
+      cond_wait(&buffer_cache_flushed, &buffer_cache_lock);
+    }
+    if(run >= 2)
+      stats.misses += run;
+    lock_release(&buffer_cache_lock);
+
+    if(run >= 2){
+      if(bounce != NULL){
+        block_read_range(fs_device, sector + i, run, bounce);
+        memcpy(buffer + i * BLOCK_SECTOR_SIZE, bounce, run * BLOCK_SECTOR_SIZE);
+      }
+      else
+        block_read_range(fs_device, sector + i, run, buffer + i * BLOCK_SECTOR_SIZE);
+      i += run;
+    }
+    else{
+      buffer_cache_read(sector + i, buffer + i * BLOCK_SECTOR_SIZE, 0, BLOCK_SECTOR_SIZE);
+      i++;
+    }
+  }
+
+  if(bounce != NULL)
+    palloc_free_page(bounce);
 }
 
 
-/* clock algorithm 사용 */
-static struct buffer_cache_entry* buffer_cache_select_victim (){
-  static size_t clock = 0;
-  while (true) {
-    ASSERT(cache[clock].valid_bit == true)
+/* sector를 pin하고 cache에 있는 데이터를 가리키는 포인터를 반환한다(복사하지 않는다).
+   buffer_cache_put()을 호출할 때까지 이 entry는 evict되지 않고, 다른 스레드는 이 sector에 접근하지 못한다.
+   need_read가 false라면 disk에서 읽지 않으므로 호출자가 sector 전체를 채워야 한다.
 
-    if (cache[clock].reference_bit) {
-      // second chance
-      cache[clock].reference_bit = false;
+   entry->lock을 잡고 있으므로 같은 sector를 두 번 get 하면 안 된다.
+   다른 entry를 잡은 채로 get 하지 않는다. 모든 entry가 pin되어 있다면 빈 entry를 기다리는 동안
+   잡고 있는 entry를 기록하려는 flusher와 서로를 기다리게 된다. */
+void* buffer_cache_get (block_sector_t sector, bool need_read){
+  return buffer_cache_acquire(sector, need_read)->buffer;
+}
+
+
+/* buffer_cache_get()으로 얻은 DATA를 놓는다. DATA를 수정했다면 dirty를 true로 넘긴다. */
+void buffer_cache_put (void *data, bool dirty){
+  struct buffer_cache_entry* slot = buffer_cache_data_to_entry(data);
+
+  if(dirty)
+    slot->dirty = true;
+  buffer_cache_release(slot);
+}
+
+
+/* sector를 비동기적으로 cache에 올려두도록 요청한다. 기다리지 않는다. */
+void buffer_cache_read_ahead (block_sector_t sector){
+  lock_acquire(&read_ahead_lock);
+  if(read_ahead_cnt == READ_AHEAD_QUEUE_SIZE){
+    lock_release(&read_ahead_lock);
+    return;
+  }
+  read_ahead_queue[(read_ahead_head + read_ahead_cnt) % READ_AHEAD_QUEUE_SIZE] = sector;
+  read_ahead_cnt++;
+  lock_release(&read_ahead_lock);
+
+  sema_up(&read_ahead_items);
+}
+
+
+/* sector를 나타내는 entry를 pin하고 entry->lock을 잡은 채로 반환한다.
+   cache에 없다면 slot을 할당하고, need_read인 경우 disk에서 읽어온다.
+   disk I/O는 buffer_cache_lock 없이 entry->lock만 잡고 일어나므로
+   같은 sector를 원하는 스레드만 기다린다. */
+static struct buffer_cache_entry* buffer_cache_acquire (block_sector_t sector, bool need_read){
+  struct buffer_cache_entry* slot;
+
+  buffer_cache_lock_global();
+  while(true){
+    slot = buffer_cache_lookup(sector);
+    if(slot != NULL){
+      // cache hit
+      slot->pin_cnt++;
+      policy->touch(slot);
+      stats.hits++;
+      if(slot->prefetched){
+        slot->prefetched = false;
+        stats.read_ahead_hits++;
+      }
+      lock_release(&buffer_cache_lock);
+
+      buffer_cache_lock_entry(slot);
+      return slot;
     }
-    else
-      return &(cache[clock]);
 
-    clock ++;
-    clock %= NUM_CACHE;
+    // cache miss. buffer_cache_allocate()가 lock을 놓았다 잡은 경우에는 다시 찾아본다.
+    slot = buffer_cache_allocate(sector, true, true);
+    if(slot != NULL)
+      break;
   }
+  stats.misses++;
+  if(need_read)
+    buffer_cache_wait_for_flush(sector, 1);
+  lock_release(&buffer_cache_lock);
+
+  /* 이 sector를 찾은 다른 스레드들은 slot->lock에서 읽기가 끝나기를 기다린다. */
+  if(need_read)
+    block_read(fs_device, sector, slot->buffer);
+  return slot;
 }
 
 
-/* 빈 슬롯이 없다면 evict 해서라도 빈 슬롯을 반환한다. */
-static struct buffer_cache_entry* buffer_cache_allocate(){
-  // 빈 슬롯이 있는 경우
-  for(int i = 0; i < NUM_CACHE; ++i){
-    if(!cache[i].valid_bit)
-      return &(cache[i]);
+/* buffer_cache_acquire()로 얻은 slot을 놓는다. */
+static void buffer_cache_release (struct buffer_cache_entry* slot){
+  lock_release(&slot->lock);
+  buffer_cache_unpin(slot);
+}
+
+
+/* buffer_cache_get()이 반환한 포인터로부터 entry를 구한다. */
+static struct buffer_cache_entry* buffer_cache_data_to_entry (void *data){
+  size_t ofs = (uint8_t*)data - cache_data;
+  ASSERT(ofs % BLOCK_SECTOR_SIZE == 0 && ofs / BLOCK_SECTOR_SIZE < cache_cnt);
+
+  struct buffer_cache_entry* slot = &cache[ofs / BLOCK_SECTOR_SIZE];
+  ASSERT(lock_held_by_current_thread(&slot->lock));
+  return slot;
+}
+
+
+static void buffer_cache_unpin (struct buffer_cache_entry* slot){
+  buffer_cache_lock_global();
+  ASSERT(slot->pin_cnt > 0);
+  if(--slot->pin_cnt == 0)
+    cond_signal(&buffer_cache_unpinned, &buffer_cache_lock);
+  lock_release(&buffer_cache_lock);
+}
+
+
+/* buffer_cache_lock을 잡는다. 기다려야 했다면 lock_waits를 센다. */
+static void buffer_cache_lock_global (void){
+  if(lock_try_acquire(&buffer_cache_lock))
+    return;
+  lock_acquire(&buffer_cache_lock);
+  stats.lock_waits++;
+}
+
+
+/* pin된 SLOT의 lock을 잡는다. 기다려야 했다면 lock_waits를 센다.
+   (lock 순서: entry->lock -> buffer_cache_lock) */
+static void buffer_cache_lock_entry (struct buffer_cache_entry* slot){
+  if(lock_try_acquire(&slot->lock))
+    return;
+  lock_acquire(&slot->lock);
+
+  buffer_cache_lock_global();
+  stats.lock_waits++;
+  lock_release(&buffer_cache_lock);
+}
+
+
+/* buffer cache 중에 sector와 일치하는 entry를 반환한다.
+   없다면 null을 반환한다. */
+static struct buffer_cache_entry* buffer_cache_lookup (block_sector_t sector){
+  ASSERT(lock_held_by_current_thread(&buffer_cache_lock));
+
+  struct buffer_cache_entry key;
+  key.disk_sector = sector;
+  struct hash_elem* e = hash_find(&buffer_cache_index, &key.index_elem);
+  if(e == NULL)
+    return NULL;
+  return hash_entry(e, struct buffer_cache_entry, index_elem);
+}
+
+
+/* 빈 슬롯이 없다면 evict 해서라도 빈 슬롯을 구한 뒤,
+   sector를 나타내는 valid entry로 만들어 색인에 등록하고 반환한다.
+   반환된 entry는 pin 되어있고 entry->lock이 잡혀있다. buffer의 내용은 호출자가 채워야 한다.
+   read-ahead로 미리 읽어두는 경우에는 referenced를 false로 넘긴다.
+
+   buffer_cache_lock을 잡은 채로 호출해야한다.
+   evict할 entry를 disk에 기록해야 하거나 모든 entry가 pin된 경우에는
+   buffer_cache_lock을 놓았다가 다시 잡고 null을 반환한다. 그 사이에 다른 스레드가
+   같은 sector를 불러왔을 수 있으므로 호출자는 다시 찾아봐야 한다.
+   may_wait가 false라면 모든 entry가 pin된 경우에 기다리지 않고 바로 null을 반환한다. */
+static struct buffer_cache_entry* buffer_cache_allocate(block_sector_t sector, bool referenced, bool may_wait){
+  ASSERT(lock_held_by_current_thread(&buffer_cache_lock));
+  struct buffer_cache_entry* empty;
+
+  if(!list_empty(&buffer_cache_free_slots)){
+    // 빈 슬롯이 있는 경우
+    empty = list_entry(list_pop_front(&buffer_cache_free_slots), struct buffer_cache_entry, free_elem);
   }
-  // 빈 슬롯이 없는 경우
-  struct buffer_cache_entry* empty = buffer_cache_select_victim();
-  if (empty->dirty) {
-    // write back into disk
-    buffer_cache_flush_entry(empty);
+  else{
+    // 빈 슬롯이 없는 경우
+    empty = policy->select_victim();
+    if (empty == NULL) {
+      if (may_wait)
+        cond_wait(&buffer_cache_unpinned, &buffer_cache_lock);
+      return NULL;
+    }
+    if (empty->dirty) {
+      /* write back into disk
+         disk에 기록하는 동안에도 이 entry는 색인에 남아있으므로,
+         같은 sector를 찾는 스레드는 disk에서 옛날 데이터를 읽지 않고 이 entry를 기다린다. */
+      empty->pin_cnt++;
+      lock_release(&buffer_cache_lock);
+
+      buffer_cache_lock_entry(empty);
+      if (empty->dirty)
+        buffer_cache_flush_entry(empty);
+      lock_release(&empty->lock);
+
+      buffer_cache_lock_global();
+      if (--empty->pin_cnt == 0)
+        cond_signal(&buffer_cache_unpinned, &buffer_cache_lock);
+      return NULL;
+    }
+    policy->remove(empty);
+    hash_delete(&buffer_cache_index, &empty->index_elem);
+    stats.evictions++;
+    empty->valid_bit = false;
   }
 
-  empty->valid_bit = false;
+  empty->valid_bit = true;
+  empty->dirty = false;
+  empty->prefetched = !referenced;
+  empty->disk_sector = sector;
+  empty->pin_cnt = 1;
+  hash_insert(&buffer_cache_index, &empty->index_elem);
+  policy->insert(empty, referenced);
+
+  /* pin_cnt가 0이었으므로 아무도 잡고있지 않다. */
+  lock_acquire(&empty->lock);
   return empty;
 }
 
 
+/* entry->lock을 잡은 채로 호출해야한다. */
 static void buffer_cache_flush_entry(struct buffer_cache_entry* entry){
   ASSERT(entry->valid_bit == true && entry->dirty == true);
+  ASSERT(lock_held_by_current_thread(&entry->lock));
+
+  /* flusher가 기록중인 옛날 데이터가 나중에 기록되어 덮어쓰지 않도록 기다린다. */
+  buffer_cache_lock_global();
+  buffer_cache_wait_for_flush(entry->disk_sector, 1);
+  lock_release(&buffer_cache_lock);
 
   block_write(fs_device, entry->disk_sector, entry->buffer);
   entry->dirty = false;
+
+  buffer_cache_lock_global();
+  stats.writebacks++;
+  lock_release(&buffer_cache_lock);
+}
+
+
+/* dirty entry들을 모두 disk에 기록한다.
+   disk head가 한 방향으로만 움직이도록 sector 순서대로 기록한다.
+   dirty sector 번호들만 모아두고, sector가 연속된 entry들을 한 run씩 pin하고 lock을 잡아 flush_buffer로 복사한다.
+   다른 스레드가 lock을 잡고 있는 entry는 기다리지 않고 건너뛴다(다음 주기에 기록된다).
+   복사한 entry는 기록 요청을 보낸 뒤 곧바로 unpin하므로 flusher가 많은 entry를 오래 pin해두지 않는다.
+   기록 요청은 기다리지 않고 연달아 보내므로 disk가 기록하는 동안 다음 entry들을 복사할 수 있다. */
+static void buffer_cache_flush_all(void){
+  block_sector_t* dirties = flush_list;
+  struct buffer_cache_entry* run_entries[FLUSH_RUN_MAX];
+  size_t cnt = 0;
+  size_t used = 0;          /* 사용한 flush_buffer의 sector 수 */
+  size_t request_cnt = 0;   /* 완료를 기다리지 않은 요청 수 */
+
+  lock_acquire(&flush_lock);
+  buffer_cache_lock_global();
+  for(size_t i = 0; i < cache_cnt; ++i){
+    if(cache[i].valid_bit && cache[i].dirty)
+      dirties[cnt++] = cache[i].disk_sector;
+  }
+  lock_release(&buffer_cache_lock);
+
+  qsort(dirties, cnt, sizeof *dirties, buffer_cache_sector_compare);
+
+  for(size_t i = 0; i < cnt; ){
+    if(used == FLUSH_BUFFER_SECTORS){
+      buffer_cache_flush_wait(request_cnt);
+      used = request_cnt = 0;
+    }
+    size_t run_max = FLUSH_BUFFER_SECTORS - used < FLUSH_RUN_MAX ? FLUSH_BUFFER_SECTORS - used : FLUSH_RUN_MAX;
+
+    /* sector가 연속된 entry들을 pin하고 lock을 잡는다. 그 사이에 evict되었거나 clean이 되었거나
+       다른 스레드가 사용중인 entry가 있다면 run은 거기서 끝난다.
+       (pin되지 않은 entry의 lock은 아무도 잡고있지 않고, 잡혀있다면 기다리지 않으므로
+       buffer_cache_lock을 잡은 채로 잡아도 된다.) */
+    size_t run = 0;
+    block_sector_t start = 0;
+    buffer_cache_lock_global();
+    for(; i < cnt && run < run_max; ++i){
+      if(run > 0 && dirties[i] != start + run)
+        break;
+      struct buffer_cache_entry* e = buffer_cache_lookup(dirties[i]);
+      if(e != NULL && lock_try_acquire(&e->lock)){
+        if(e->dirty){
+          if(run == 0)
+            start = dirties[i];
+          e->pin_cnt++;
+          run_entries[run++] = e;
+          continue;
+        }
+        lock_release(&e->lock);
+      }
+      if(run > 0){
+        ++i;
+        break;
+      }
+    }
+    lock_release(&buffer_cache_lock);
+    if(run == 0)
+      continue;
+
+    uint8_t* data = flush_buffer + used * BLOCK_SECTOR_SIZE;
+    for(size_t j = 0; j < run; ++j){
+      struct buffer_cache_entry* e = run_entries[j];
+      memcpy(data + j * BLOCK_SECTOR_SIZE, e->buffer, BLOCK_SECTOR_SIZE);
+      e->dirty = false;
+      lock_release(&e->lock);
+    }
+    flush_runs[request_cnt].start = start;
+    flush_runs[request_cnt].cnt = run;
+    block_submit(fs_device, &flush_requests[request_cnt++], true,
+                 start, run, data, NULL, NULL);
+
+    /* 요청을 flush_pending_cnt에 등록한 뒤에 unpin한다. 이후 evict되더라도
+       이 sector를 읽으려는 스레드는 기록이 끝나기를 기다린다. */
+    buffer_cache_lock_global();
+    flush_pending_cnt = request_cnt;
+    stats.writebacks += run;
+    for(size_t j = 0; j < run; ++j){
+      if(--run_entries[j]->pin_cnt == 0)
+        cond_signal(&buffer_cache_unpinned, &buffer_cache_lock);
+    }
+    lock_release(&buffer_cache_lock);
+
+    used += run;
+  }
+  buffer_cache_flush_wait(request_cnt);
+  lock_release(&flush_lock);
+}
+
+
+/* flush_requests의 처음 request_cnt개 요청이 끝나기를 기다린 뒤,
+   그 sector들을 기다리던 스레드들을 깨운다. */
+static void buffer_cache_flush_wait(size_t request_cnt){
+  for(size_t i = 0; i < request_cnt; ++i)
+    block_wait(&flush_requests[i]);
+
+  buffer_cache_lock_global();
+  flush_pending_cnt = 0;
+  cond_broadcast(&buffer_cache_flushed, &buffer_cache_lock);
+  lock_release(&buffer_cache_lock);
 }
 
 
-static void buffer_cache_flush_all(){
-  for(int i = 0; i < NUM_CACHE; ++i){
-    if(cache[i].valid_bit && cache[i].dirty){
-      buffer_cache_flush_entry(&(cache[i]));
-      cache[i].dirty = false;
+/* SECTOR부터 CNT개의 sector 중 하나라도 아직 끝나지 않은 flusher의 기록 요청에 포함되어 있다면 true.
+   buffer_cache_lock을 잡은 채로 호출한다. */
+static bool buffer_cache_flush_pending(block_sector_t sector, size_t cnt){
+  ASSERT(lock_held_by_current_thread(&buffer_cache_lock));
+
+  for(size_t i = 0; i < flush_pending_cnt; ++i){
+    const struct flush_run* f = &flush_runs[i];
+    if(!block_poll(&flush_requests[i]) && f->start < sector + cnt && sector < f->start + f->cnt)
+      return true;
+  }
+  return false;
+}
+
+
+/* SECTOR부터 CNT개의 sector에 대한 flusher의 기록이 끝날 때까지 기다린다.
+   buffer_cache_lock을 잡은 채로 호출하며, 기다리는 동안에는 놓는다. */
+static void buffer_cache_wait_for_flush(block_sector_t sector, size_t cnt){
+  while(buffer_cache_flush_pending(sector, cnt))
+    cond_wait(&buffer_cache_flushed, &buffer_cache_lock);
+}
+
+
+/* write-behind 스레드. */
+static void buffer_cache_flusher (void *aux UNUSED){
+  while(!buffer_cache_terminating){
+    timer_sleep(BUFFER_CACHE_FLUSH_INTERVAL);
+    if(!buffer_cache_terminating)
+      buffer_cache_flush_all();
+  }
+}
+
+
+/* read-ahead 스레드. 큐에서 sector들을 꺼내 cache에 올려둔다.
+   꺼낸 sector들의 읽기 요청을 한꺼번에 보내므로 disk queue에서 정렬되고 합쳐질 수 있다.
+   disk를 기다리는 동안 요청한 스레드는 이미 cache에 있는 sector를 복사할 수 있다. */
+static void buffer_cache_read_aheader (void *aux UNUSED){
+  struct block_request requests[READ_AHEAD_BATCH];
+  struct buffer_cache_entry* slots[READ_AHEAD_BATCH];
+
+  while(true){
+    int cnt = 0;
+
+    sema_down(&read_ahead_items);
+    do{
+      lock_acquire(&read_ahead_lock);
+      block_sector_t sector = read_ahead_queue[read_ahead_head];
+      read_ahead_head = (read_ahead_head + 1) % READ_AHEAD_QUEUE_SIZE;
+      read_ahead_cnt--;
+      lock_release(&read_ahead_lock);
+
+      if(buffer_cache_terminating)
+        continue;
+      /* 이미 slot을 잡고 있다면 다른 스레드의 unpin을 기다리다 교착될 수 있으므로
+         첫 sector만 기다릴 수 있다. */
+      slots[cnt] = buffer_cache_prefetch(sector, cnt == 0, &requests[cnt]);
+      if(slots[cnt] != NULL)
+        cnt++;
+    } while(cnt < READ_AHEAD_BATCH && sema_try_down(&read_ahead_items));
+
+    for(int i = 0; i < cnt; ++i){
+      block_wait(&requests[i]);
+      buffer_cache_release(slots[i]);
     }
   }
-}
\ No newline at end of file
+}
+
+
+/* sector가 cache에 없다면 slot을 할당하고 disk에서 읽는 요청을 REQUEST로 보낸다.
+   REQUEST가 끝나기를 기다린 뒤 buffer_cache_release() 해야하는 slot을 반환한다.
+   이미 있다면 아무것도 하지 않고 null을 반환한다(사용중인 entry를 기다리지 않는다).
+   may_wait가 false라면 빈 slot이 없을 때에도 기다리지 않고 null을 반환한다. */
+static struct buffer_cache_entry* buffer_cache_prefetch (block_sector_t sector, bool may_wait, struct block_request* request){
+  struct buffer_cache_entry* slot;
+
+  buffer_cache_lock_global();
+  while(true){
+    if(buffer_cache_lookup(sector) != NULL){
+      lock_release(&buffer_cache_lock);
+      return NULL;
+    }
+    /* 아직 아무도 참조하지 않았으므로 쓰이지 않는다면 먼저 evict 되도록 한다. */
+    slot = buffer_cache_allocate(sector, false, may_wait);
+    if(slot != NULL)
+      break;
+    if(!may_wait){
+      lock_release(&buffer_cache_lock);
+      return NULL;
+    }
+  }
+  stats.read_aheads++;
+  buffer_cache_wait_for_flush(sector, 1);
+  lock_release(&buffer_cache_lock);
+
+  block_submit(fs_device, request, false, sector, 1, slot->buffer, NULL, NULL);
+  return slot;
+}
+
+
+/* clock 정책.
+   cache 배열을 원형으로 돌며 reference_bit가 꺼진 entry를 고른다(second chance). */
+static size_t clock_hand;
+
+static void clock_init (void){
+  clock_hand = 0;
+}
+
+static void clock_touch (struct buffer_cache_entry *entry){
+  entry->reference_bit = true;
+}
+
+static void clock_insert (struct buffer_cache_entry *entry, bool referenced){
+  entry->reference_bit = referenced;
+}
+
+static void clock_remove (struct buffer_cache_entry *entry UNUSED){
+}
+
+/* pin된 entry는 건너뛴다. dirty entry는 flusher가 곧 기록해줄 것이므로 clean entry를 먼저 고른다.
+   두 바퀴를 돌아도 clean entry가 없다면 처음 만난 dirty entry를,
+   그것도 없다면(모두 pin된 경우) null을 반환한다. */
+static struct buffer_cache_entry* clock_select_victim (void){
+  struct buffer_cache_entry* dirty_victim = NULL;
+  for (size_t i = 0; i < 2 * cache_cnt; ++i) {
+    struct buffer_cache_entry* e = &(cache[clock_hand]);
+    clock_hand ++;
+    clock_hand %= cache_cnt;
+
+    ASSERT(e->valid_bit == true)
+    if (e->pin_cnt > 0)
+      continue;
+
+    if (e->reference_bit) {
+      // second chance
+      e->reference_bit = false;
+    }
+    else if (!e->dirty)
+      return e;
+    else if (dirty_victim == NULL)
+      dirty_victim = e;
+  }
+  return dirty_victim;
+}
+
+
+/* 2Q 정책 (Johnson & Shasha).
+   처음 읽힌 sector는 FIFO인 A1in에 들어간다. A1in에서 밀려난 sector 번호는
+   A1out에 기억해두고, A1out에 있는 동안 다시 읽히면 자주 쓰이는 sector로 보고 LRU인 Am에 넣는다.
+   큰 파일을 한 번 순차적으로 읽어도 A1in만 돌게 되므로 Am에 있는 inode, free-map,
+   directory sector들이 밀려나지 않는다. */
+#define TWO_Q_A1IN_SIZE (cache_cnt / 4)
+#define TWO_Q_A1OUT_SIZE (cache_cnt / 2)
+
+static struct list two_q_a1in;      /* 오래된 것이 앞 */
+static struct list two_q_am;        /* least recently used가 앞 */
+static size_t two_q_a1in_cnt;
+
+/* A1out: evict된 sector 번호만 기억하는 원형 큐.
+   miss 때만 찾아보며 그 때는 어차피 disk를 읽으므로 선형 탐색으로 충분하다. */
+static block_sector_t* two_q_a1out;
+static size_t two_q_a1out_head, two_q_a1out_cnt;
+
+static void two_q_init (void){
+  list_init (&two_q_a1in);
+  list_init (&two_q_am);
+  two_q_a1in_cnt = 0;
+  two_q_a1out_head = two_q_a1out_cnt = 0;
+  two_q_a1out = buffer_cache_alloc_array (TWO_Q_A1OUT_SIZE * sizeof *two_q_a1out);
+}
+
+static void two_q_touch (struct buffer_cache_entry *entry){
+  /* A1in에 있는 동안의 재참조는 짧은 시간 안의 상관된 참조로 보고 무시한다. */
+  if (entry->hot){
+    list_remove (&entry->policy_elem);
+    list_push_back (&two_q_am, &entry->policy_elem);
+  }
+}
+
+/* A1out에 SECTOR가 있다면 지우고 true를 반환한다. */
+static bool two_q_a1out_remove (block_sector_t sector){
+  for (size_t i = 0; i < two_q_a1out_cnt; ++i){
+    size_t idx = (two_q_a1out_head + i) % TWO_Q_A1OUT_SIZE;
+    if (two_q_a1out[idx] == sector){
+      /* 더 최근에 들어온 것들을 한 칸씩 당겨서 빈 자리를 메운다. FIFO 순서가 유지된다. */
+      for (size_t j = i + 1; j < two_q_a1out_cnt; ++j){
+        size_t next = (two_q_a1out_head + j) % TWO_Q_A1OUT_SIZE;
+        two_q_a1out[idx] = two_q_a1out[next];
+        idx = next;
+      }
+      two_q_a1out_cnt--;
+      return true;
+    }
+  }
+  return false;
+}
+
+static void two_q_insert (struct buffer_cache_entry *entry, bool referenced){
+  /* prefetch는 아직 참조된 것이 아니므로 A1out에 있더라도 Am으로 올리지 않는다. */
+  if (referenced && two_q_a1out_remove (entry->disk_sector)){
+    entry->hot = true;
+    list_push_back (&two_q_am, &entry->policy_elem);
+  }
+  else{
+    entry->hot = false;
+    list_push_back (&two_q_a1in, &entry->policy_elem);
+    two_q_a1in_cnt++;
+  }
+}
+
+static void two_q_remove (struct buffer_cache_entry *entry){
+  list_remove (&entry->policy_elem);
+  if (entry->hot)
+    return;
+
+  two_q_a1in_cnt--;
+  if (two_q_a1out_cnt == TWO_Q_A1OUT_SIZE){
+    two_q_a1out_head = (two_q_a1out_head + 1) % TWO_Q_A1OUT_SIZE;
+    two_q_a1out_cnt--;
+  }
+  two_q_a1out[(two_q_a1out_head + two_q_a1out_cnt) % TWO_Q_A1OUT_SIZE] = entry->disk_sector;
+  two_q_a1out_cnt++;
+}
+
+/* LIST의 앞에서부터 pin되지 않은 clean entry를 찾는다.
+   없다면 처음 만난 pin되지 않은 dirty entry를, 그것도 없다면 null을 반환한다. */
+static struct buffer_cache_entry* two_q_scan (struct list *list){
+  struct buffer_cache_entry* dirty_victim = NULL;
+  for (struct list_elem *e = list_begin (list); e != list_end (list); e = list_next (e)){
+    struct buffer_cache_entry* entry = list_entry (e, struct buffer_cache_entry, policy_elem);
+    if (entry->pin_cnt > 0)
+      continue;
+    if (!entry->dirty)
+      return entry;
+    if (dirty_victim == NULL)
+      dirty_victim = entry;
+  }
+  return dirty_victim;
+}
+
+static struct buffer_cache_entry* two_q_select_victim (void){
+  struct list *first = two_q_a1in_cnt > TWO_Q_A1IN_SIZE ? &two_q_a1in : &two_q_am;
+  struct list *second = first == &two_q_a1in ? &two_q_am : &two_q_a1in;
+
+  struct buffer_cache_entry* victim = two_q_scan (first);
+  if (victim == NULL)
+    victim = two_q_scan (second);
+  return victim;
+}
+
+
+/* SIZE bytes 짜리 배열을 kernel pool에서 할당한다. 부팅 중에만 호출하므로 실패하면 panic. */
+static void* buffer_cache_alloc_array (size_t size){
+  return palloc_get_multiple (PAL_ASSERT, DIV_ROUND_UP (size, PGSIZE));
+}
+
+
+/* qsort()용. pin된 entry들이므로 disk_sector는 바뀌지 않는다. */
+static int buffer_cache_sector_compare (const void *a, const void *b){
+  block_sector_t sector_a = *(const block_sector_t *)a;
+  block_sector_t sector_b = *(const block_sector_t *)b;
+  if(sector_a < sector_b)
+    return -1;
+  return sector_a > sector_b;
+}
+
+
+/* hash function들 */
+static unsigned buffer_cache_hash_func (const struct hash_elem *e, void *aux UNUSED){
+  struct buffer_cache_entry* entry = hash_entry(e, struct buffer_cache_entry, index_elem);
+  return hash_int((int)entry->disk_sector);
+}
+static bool buffer_cache_less_func (const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED){
+  struct buffer_cache_entry* entry_a = hash_entry(a, struct buffer_cache_entry, index_elem);
+  struct buffer_cache_entry* entry_b = hash_entry(b, struct buffer_cache_entry, index_elem);
+  return entry_a->disk_sector < entry_b->disk_sector;
+}
@@ -1,13 +1,27 @@
 #ifndef FILESYS_CACHE_H
 #define FILESYS_CACHE_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include "devices/block.h"
 
+bool buffer_cache_set_policy (const char *name);
+bool buffer_cache_set_size (int cnt);
 void buffer_cache_init (void);
 void buffer_cache_terminate (void);
+void buffer_cache_print_stats (void);
+struct cache_stats;
+void buffer_cache_get_stats (struct cache_stats *dst);
 
 void buffer_cache_read (block_sector_t sector, void *buffer, int sector_ofs, int chunk_size);
 
 void buffer_cache_write (block_sector_t sector, void *buffer, int sector_ofs, int chunk_size);
 
+void buffer_cache_read_sectors (block_sector_t sector, size_t cnt, void *buffer);
+
+void *buffer_cache_get (block_sector_t sector, bool need_read);
+void buffer_cache_put (void *data, bool dirty);
+
+void buffer_cache_read_ahead (block_sector_t sector);
+
 #endif
\ No newline at end of file
@@ -12,6 +12,12 @@
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* 순차 읽기가 감지되면 이만큼의 sector를 미리 읽어둔다. */
+#define READ_AHEAD_SECTORS 8
+
+/* inode_read_at()이 한 번에 모으는 물리적으로 연속된 sector의 최대 개수. */
+#define READ_RUN_MAX 64
+
 /* 특정 inode에 대해 접근을 막는 lock.(very very strongly)
    동일한 inode는 sync 하게 open 하는데 필요하다. */
 static struct lock** inode_lock;
@@ -37,6 +43,31 @@ min (size_t a, size_t b)
 }
 
 
+/* indirect block SECTOR의 IDX번째 pointer를 반환한다.
+   sector 전체를 복사하지 않고 buffer cache 안에서 바로 읽는다. */
+static block_sector_t
+inode_read_pointer (block_sector_t sector, off_t idx)
+{
+  block_sector_t *indirect_block = buffer_cache_get (sector, true);
+  block_sector_t pointer = indirect_block[idx];
+  buffer_cache_put (indirect_block, false);
+  return pointer;
+}
+
+/* sector를 하나 할당하고 0으로 초기화해서 *SECTORP에 저장한다. */
+static bool
+inode_allocate_zeroed (block_sector_t *sectorp)
+{
+  if (!free_map_allocate (1, sectorp))
+    return false;
+
+  void *data = buffer_cache_get (*sectorp, false);
+  memset (data, 0, BLOCK_SECTOR_SIZE);
+  buffer_cache_put (data, true);
+  return true;
+}
+
+
 /* Returns the block device sector that contains byte offset POS
    within INODE.
    Returns -1 if INODE does not contain data for a byte at offset
@@ -61,25 +92,18 @@ byte_to_sector (const struct inode *inode, off_t pos)
     start = end;
     end += NUM_POINTER_BLOCKS;
     if (pos_to_sectors < end) {
-      block_sector_t indirect_block[NUM_POINTER_BLOCKS];
-      buffer_cache_read (idisk->indirect_block, indirect_block, 0, BLOCK_SECTOR_SIZE);
-
-      return indirect_block[pos_to_sectors - start];
+      return inode_read_pointer (idisk->indirect_block, pos_to_sectors - start);
     }
 
     // doubly indirect block
     start = end;
     end += NUM_POINTER_BLOCKS * NUM_POINTER_BLOCKS;
     if (pos_to_sectors < end) {
-      block_sector_t first_indirect_block[NUM_POINTER_BLOCKS];
-      buffer_cache_read (idisk->doubly_indirect_block, first_indirect_block, 0, BLOCK_SECTOR_SIZE);
-
       off_t first_offt =  (pos_to_sectors - start) / NUM_POINTER_BLOCKS;
-      block_sector_t second_indirect_block[NUM_POINTER_BLOCKS];
-      buffer_cache_read (first_indirect_block[first_offt], second_indirect_block, 0, BLOCK_SECTOR_SIZE);
+      block_sector_t second_indirect_block = inode_read_pointer (idisk->doubly_indirect_block, first_offt);
 
       off_t second_offt = (pos_to_sectors - start) % NUM_POINTER_BLOCKS;
-      return second_indirect_block[second_offt];
+      return inode_read_pointer (second_indirect_block, second_offt);
     }
   }
   else
@@ -89,85 +113,72 @@ byte_to_sector (const struct inode *inode, off_t pos)
 
 
 /* indirect_block_root 이 나타내는 indirect_blocks의 개수를
-   num_indirect_block 로 설정한다. */
+   num_indirect_block 로 설정한다.
+   새 block을 할당하면 buffer cache의 entry를 새로 잡아야 하므로, indirect block의 entry를 잡은 채로
+   할당하지 않는다. (모든 entry가 pin된 상태라면 indirect block을 잡은 채로 unpin을 기다리게 되고,
+   그 indirect block을 기록하려는 flusher와 서로를 기다린다.)
+   pointer들을 복사해온 뒤 새 block들을 할당하여 0으로 초기화하고, 마지막에 한 번만 indirect block에 적는다.
+   파일의 크기는 inode의 extend_lock을 잡고서만 늘어나므로 그 사이에 다른 스레드가 이 indirect block을 바꾸지 않는다. */
 static bool inode_set_indirect_block(block_sector_t* indirect_block_root, off_t num_indirect_block){
-  static char zeros[BLOCK_SECTOR_SIZE];
-
   // indirect_block_root 이 아직 초기화되지 않은 경우, indirect_block을 할당해주고 0으로 초기화한다.
   if(*indirect_block_root == 0){
-    if(!free_map_allocate(1, indirect_block_root))
+    if(!inode_allocate_zeroed(indirect_block_root))
       return false;
-    buffer_cache_write(*indirect_block_root, zeros, 0, BLOCK_SECTOR_SIZE);
   }
 
-  // indirect_block을 읽어온다.
   block_sector_t indirect_block[NUM_POINTER_BLOCKS];
   buffer_cache_read(*indirect_block_root, indirect_block, 0, BLOCK_SECTOR_SIZE);
+  bool success = true;
+  bool dirty = false;
 
   for(int i = 0; i < num_indirect_block; ++i){
     // 기존에 유효하지 않은 indirect block의 경우 새로 할당하고 0으로 초기화한다.
     if(indirect_block[i] == 0){
-      if(! free_map_allocate(1, &indirect_block[i]))
-        return false;
-      buffer_cache_write(indirect_block[i], zeros, 0, BLOCK_SECTOR_SIZE);
+      if(! inode_allocate_zeroed(&indirect_block[i])){
+        success = false;
+        break;
+      }
+      dirty = true;
     }
   }
 
-  //indirect block 을 저장한다.
-  buffer_cache_write(*indirect_block_root, indirect_block, 0, BLOCK_SECTOR_SIZE);
-  return true;
+  // 실패하더라도 할당한 block들은 기록해두어야 나중에 해제된다.
+  if(dirty)
+    buffer_cache_write(*indirect_block_root, indirect_block, 0, BLOCK_SECTOR_SIZE);
+  return success;
 }
 
 
 /* idoubly_block_root 이 나타내는 doubly blocks의 개수를
-   num_doubly_block 로 설정한다. */
+   num_doubly_block 로 설정한다.
+   inode_set_indirect_block()과 마찬가지로 first indirect block의 entry를 잡은 채로
+   second indirect block을 할당하지 않는다. pointer를 하나씩 읽고, 바뀐 pointer만 적는다. */
 static bool 
 inode_set_doubly_indirect_block(block_sector_t* doubly_block_root, size_t num_doubly_block)
 {
-  static char zeros[BLOCK_SECTOR_SIZE];
-
   // doubly_block_root 이 아직 초기화되지 않은 경우, first indirect block을 할당해주고 0으로 초기화한다.
   if(*doubly_block_root == 0){
-    if(!free_map_allocate(1, doubly_block_root))
+    if(!inode_allocate_zeroed(doubly_block_root))
       return false;
-    buffer_cache_write(*doubly_block_root, zeros, 0, BLOCK_SECTOR_SIZE);
   }
 
-  //first indirect_block을 읽어온다.
-  block_sector_t first_indirect_block[NUM_POINTER_BLOCKS];
-  buffer_cache_read(*doubly_block_root, first_indirect_block, 0, BLOCK_SECTOR_SIZE);
-
   int first_offt = (num_doubly_block - 1) / NUM_POINTER_BLOCKS;
   for(int i = 0; i <= first_offt; ++i){
+    // 마지막 first indirect block entry의 경우에는 second indirect block을
+    // 128개 전부가 아닌 일부만 채워야 한다.
+    int num_second = i == first_offt ? ((num_doubly_block - 1) % NUM_POINTER_BLOCKS) + 1 : NUM_POINTER_BLOCKS;
 
     //유효하지 않은 first_indirect_block의 경우 second_indirect_block을 할당하고 초기화한다.
-    if(first_indirect_block[i] == 0){
-      if(! free_map_allocate(1, &first_indirect_block[i]))
-        return false;
-      buffer_cache_write(first_indirect_block[i], zeros, 0, BLOCK_SECTOR_SIZE);
-    }
-
-    // second indirect block을 읽어온다.
-    block_sector_t second_indirect_block[NUM_POINTER_BLOCKS];
-    buffer_cache_read(first_indirect_block[i], second_indirect_block, 0, BLOCK_SECTOR_SIZE);
-
-    // 마지막 first indirect block entry의 경우에는 second indirect block을 읽을 때
-    // 128개 전부가 아닌 일부만 읽어야 한다.
-    int second_offt = i == first_offt ? ((num_doubly_block - 1) % NUM_POINTER_BLOCKS) : (NUM_POINTER_BLOCKS - 1);
-
-    for(int j = 0; j <= second_offt; ++j){
-      //유효하지 않은 second_indirect_block의 경우 데이터를 저장할 block을 할당하고 초기화한다.
-      if(second_indirect_block[j] == 0){
-        if(! free_map_allocate(1, &second_indirect_block[j]))
-          return false;
-        buffer_cache_write(second_indirect_block[j], zeros, 0, BLOCK_SECTOR_SIZE);
-      }
-    }
-
-    buffer_cache_write(first_indirect_block[i], second_indirect_block, 0, BLOCK_SECTOR_SIZE);
+    block_sector_t second_indirect_block = inode_read_pointer(*doubly_block_root, i);
+    bool was_allocated = second_indirect_block != 0;
+    bool success = inode_set_indirect_block(&second_indirect_block, num_second);
+
+    if(!was_allocated && second_indirect_block != 0)
+      buffer_cache_write(*doubly_block_root, &second_indirect_block,
+                         i * sizeof second_indirect_block, sizeof second_indirect_block);
+    if(!success)
+      return false;
   }
-
-  buffer_cache_write(*doubly_block_root, first_indirect_block, 0, BLOCK_SECTOR_SIZE);
   return true;
 }
 
@@ -180,16 +191,14 @@ static bool inode_set_file_length(struct inode_disk* idisk, off_t new_bytes){
   if(new_bytes > MAX_FILE_LENGTH) return false;
 
   size_t new_blocks = bytes_to_sectors(new_bytes);
-  static char zeros[BLOCK_SECTOR_SIZE];
 
   /* direct blocks */
   int num_direct_blocks = min(new_blocks, NUM_DIRECT_BLOCKS);
   int i;
   for (i = 0; i < num_direct_blocks; ++ i) {
     if (idisk->direct_blocks[i] == 0) {
-      if(! free_map_allocate (1, &idisk->direct_blocks[i]))
+      if(! inode_allocate_zeroed (&idisk->direct_blocks[i]))
         return false;
-      buffer_cache_write (idisk->direct_blocks[i], zeros, 0, BLOCK_SECTOR_SIZE);
     }
   }
   new_blocks -= num_direct_blocks;
@@ -221,9 +230,6 @@ static void inode_deallocate_indirect (block_sector_t entry, size_t num_sectors,
     return;
   }
 
-  block_sector_t indirect_block[NUM_POINTER_BLOCKS];
-  buffer_cache_read(entry, indirect_block, 0, BLOCK_SECTOR_SIZE);
-
   size_t unit;
   if(level == 1)
     unit = 1;
@@ -234,7 +240,8 @@ static void inode_deallocate_indirect (block_sector_t entry, size_t num_sectors,
 
   for (int i = 0; i < offset; ++i) {
     size_t subsize = min(num_sectors, unit);
-    inode_deallocate_indirect (indirect_block[i], subsize, level - 1);
+    // 하위 block을 해제하는 동안 이 block을 잡고 있지 않도록 pointer 하나씩 읽는다.
+    inode_deallocate_indirect (inode_read_pointer (entry, i), subsize, level - 1);
     num_sectors -= subsize;
   }
 
@@ -409,6 +416,7 @@ inode_open (block_sector_t sector)
   inode->sector = sector;
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
+  lock_init (&inode->extend_lock);
 
 #ifdef USERPROG
   inode->read_cnt = 0;
@@ -417,6 +425,8 @@ inode_open (block_sector_t sector)
 #endif
 
   inode->removed = false;
+  inode->read_ahead_pos = 0;
+  inode->read_ahead_end = 0;
   buffer_cache_read (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
 
 
@@ -502,6 +512,46 @@ inode_remove (struct inode *inode)
   inode->removed = true;
 }
 
+/* OFFSET부터 최대 BYTES bytes에 해당하는 sector들 중, SECTOR부터
+   disk에서도 연속된 sector의 개수를 반환한다. OFFSET은 SECTOR의 시작이어야 한다. */
+static size_t
+inode_contiguous_sectors (const struct inode *inode, block_sector_t sector,
+                          off_t offset, off_t bytes)
+{
+  size_t cnt = 1;
+
+  while (cnt < READ_RUN_MAX
+         && (off_t) (cnt + 1) * BLOCK_SECTOR_SIZE <= bytes
+         && byte_to_sector (inode, offset + cnt * BLOCK_SECTOR_SIZE) == sector + cnt)
+    cnt++;
+  return cnt;
+}
+
+/* 순차적으로 읽는 중일 때 호출한다. POS 다음의 READ_AHEAD_SECTORS개 sector를
+   byte_to_sector()로 구해서 buffer cache에 미리 읽어두도록 요청한다.
+   이미 요청한 sector는 다시 요청하지 않는다. */
+static void
+inode_read_ahead (struct inode *inode, off_t pos)
+{
+  off_t start = ROUND_UP (pos, BLOCK_SECTOR_SIZE);
+  off_t end = start + READ_AHEAD_SECTORS * BLOCK_SECTOR_SIZE;
+  off_t ofs;
+
+  if (start < inode->read_ahead_end)
+    start = inode->read_ahead_end;
+
+  for (ofs = start; ofs < end; ofs += BLOCK_SECTOR_SIZE)
+    {
+      block_sector_t sector = byte_to_sector (inode, ofs);
+      if (sector == -1u)
+        break;
+      buffer_cache_read_ahead (sector);
+    }
+
+  if (ofs > inode->read_ahead_end)
+    inode->read_ahead_end = ofs;
+}
+
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
    Returns the number of bytes actually read, which may be less
    than SIZE if an error occurs or end of file is reached. */
@@ -511,6 +561,12 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
 
+  /* 직전 읽기가 끝난 곳부터 다시 읽는다면 순차적으로 읽는 중이라 여긴다.
+     여러 스레드가 같은 inode를 읽으면 틀릴 수 있지만 read-ahead는 힌트일 뿐이다. */
+  bool sequential = offset == inode->read_ahead_pos;
+  if (!sequential)
+    inode->read_ahead_end = 0;
+
   /* Critical section
      Reading happens */
   while (size > 0) 
@@ -529,6 +585,22 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       if (chunk_size <= 0)
         break;
 
+      /* sector 전체를 읽는 경우, disk에서도 연속된 sector들은 모아서 한 번에 읽는다. */
+      if (chunk_size == BLOCK_SECTOR_SIZE)
+        {
+          off_t whole = size < inode_left ? size : inode_left;
+          size_t cnt = inode_contiguous_sectors (inode, sector_idx, offset, whole);
+          if (cnt > 1)
+            {
+              buffer_cache_read_sectors (sector_idx, cnt, buffer + bytes_read);
+              chunk_size = cnt * BLOCK_SECTOR_SIZE;
+              size -= chunk_size;
+              offset += chunk_size;
+              bytes_read += chunk_size;
+              continue;
+            }
+        }
+
       /* 5.3.4) bounce buffer을 없애야한다. 대신에 buffer cache로 바로 복사한다(proj5). */
       buffer_cache_read(sector_idx, buffer + bytes_read, sector_ofs, chunk_size);
 
@@ -538,6 +610,10 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       bytes_read += chunk_size;
     }
 
+  inode->read_ahead_pos = offset;
+  if (sequential && bytes_read > 0)
+    inode_read_ahead (inode, offset);
+
   return bytes_read;
 }
 
@@ -555,14 +631,23 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 
   // end of file에 도달하였다.
   if( byte_to_sector(inode, offset + size - 1) == -1u ) {
-    // offset + size bytes 로 파일의 크기를 설정한다.
-    bool success;
-    success = inode_set_file_length (& inode->data, offset + size);
-    if (!success) return 0;
-
-    // inode_disk에서 설정한 내용들을 실제 on-disk에 반영한다.
-    inode->data.length = offset + size;
-    buffer_cache_write (inode->sector, & inode->data, 0, BLOCK_SECTOR_SIZE);
+    /* 같은 파일을 동시에 늘리는 스레드가 있다면 기다린 뒤 다시 확인한다.
+       inode_set_file_length()는 indirect block을 복사해서 수정하므로 동시에 늘리면 안된다. */
+    lock_acquire (&inode->extend_lock);
+    if( byte_to_sector(inode, offset + size - 1) == -1u ) {
+      // offset + size bytes 로 파일의 크기를 설정한다.
+      bool success;
+      success = inode_set_file_length (& inode->data, offset + size);
+      if (!success) {
+        lock_release (&inode->extend_lock);
+        return 0;
+      }
+
+      // inode_disk에서 설정한 내용들을 실제 on-disk에 반영한다.
+      inode->data.length = offset + size;
+      buffer_cache_write (inode->sector, & inode->data, 0, BLOCK_SECTOR_SIZE);
+    }
+    lock_release (&inode->extend_lock);
   }
 
   /* Critical section
@@ -49,6 +49,10 @@ struct inode
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
     struct inode_disk data;             /* Inode content. */
+
+    off_t read_ahead_pos;               /* 순차적으로 읽는 중이라면 다음 inode_read_at()의 offset. */
+    off_t read_ahead_end;               /* 이 offset 전까지는 이미 read-ahead를 요청했다. */
+    struct lock extend_lock;            /* 파일의 크기를 늘리는 스레드는 하나뿐이도록 한다. */
   
 #ifdef USERPROG                      
     int read_cnt;
@@ -0,0 +1,18 @@
+#ifndef __LIB_CACHE_STATS_H
+#define __LIB_CACHE_STATS_H
+
+/* Buffer cache statistics.
+   Shared by the kernel and user programs, which obtain a copy
+   with the cache_stats() system call. */
+struct cache_stats
+  {
+    unsigned long long hits;            /* Lookups found in the cache. */
+    unsigned long long misses;          /* Lookups that had to allocate. */
+    unsigned long long evictions;       /* Valid entries rebound to a new sector. */
+    unsigned long long writebacks;      /* Dirty sectors written to disk. */
+    unsigned long long read_aheads;     /* Sectors loaded by read-ahead. */
+    unsigned long long read_ahead_hits; /* Read-ahead sectors later used. */
+    unsigned long long lock_waits;      /* Times a cache lock was contended. */
+  };
+
+#endif /* lib/cache-stats.h */
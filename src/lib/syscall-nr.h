@@ -30,7 +30,10 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Instrumentation. */
+    SYS_CACHE_STATS             /* Reads buffer cache statistics. */
   };
 
 #endif /* lib/syscall-nr.h */
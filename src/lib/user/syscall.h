@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include <cache-stats.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -48,4 +49,7 @@ int inumber (int fd);
 int fibonacci(int n);
 int max_of_four_int(int a, int b, int c, int d);
 
+/* Instrumentation. */
+void cache_stats (struct cache_stats *stats);
+
 #endif /* lib/user/syscall.h */
@@ -0,0 +1,67 @@
+/* Rewrites two files in turn with a buffer cache smaller than
+   either of them, reading each back right after the other is
+   rewritten.  Every rewrite evicts the other file's sectors,
+   some of them while the write-behind thread is still writing
+   them out, so the reads must wait for those writes instead of
+   fetching stale data from the disk.  Run with -cache=32. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE (48 * 512)
+#define ROUNDS 50
+
+static const char *file_names[2] = {"a", "b"};
+static char bufs[2][FILE_SIZE];
+static char readbuf[FILE_SIZE];
+
+static void
+rewrite (int fd, char *buf, const char *file_name)
+{
+  random_bytes (buf, FILE_SIZE);
+  seek (fd, 0);
+  if (write (fd, buf, FILE_SIZE) != FILE_SIZE)
+    fail ("write \"%s\" failed", file_name);
+}
+
+static void
+read_back (int fd, const char *buf, const char *file_name)
+{
+  seek (fd, 0);
+  if (read (fd, readbuf, FILE_SIZE) != FILE_SIZE)
+    fail ("read \"%s\" failed", file_name);
+  compare_bytes (readbuf, buf, FILE_SIZE, 0, file_name);
+}
+
+void
+test_main (void)
+{
+  int fds[2];
+  int i;
+
+  for (i = 0; i < 2; i++)
+    {
+      CHECK (create (file_names[i], 0), "create \"%s\"", file_names[i]);
+      CHECK ((fds[i] = open (file_names[i])) > 1,
+             "open \"%s\"", file_names[i]);
+      rewrite (fds[i], bufs[i], file_names[i]);
+    }
+
+  msg ("rewrite and read back %d times", ROUNDS);
+  for (i = 0; i < ROUNDS; i++)
+    {
+      int cur = i % 2;
+      int other = !cur;
+
+      rewrite (fds[cur], bufs[cur], file_names[cur]);
+      read_back (fds[other], bufs[other], file_names[other]);
+    }
+
+  for (i = 0; i < 2; i++)
+    {
+      msg ("close \"%s\"", file_names[i]);
+      close (fds[i]);
+    }
+}
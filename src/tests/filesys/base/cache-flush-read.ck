@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(cache-flush-read) begin
+(cache-flush-read) create "a"
+(cache-flush-read) open "a"
+(cache-flush-read) create "b"
+(cache-flush-read) open "b"
+(cache-flush-read) rewrite and read back 50 times
+(cache-flush-read) close "a"
+(cache-flush-read) close "b"
+(cache-flush-read) end
+EOF
+pass;
@@ -0,0 +1,54 @@
+/* Writes a small file, reads it back once to warm the buffer
+   cache, and then checks with the cache_stats system call that
+   reading it again hits in the cache without any misses. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define TEST_SIZE 2048
+static char buf[TEST_SIZE];
+
+static void
+read_file (const char *file_name) 
+{
+  static char readbuf[TEST_SIZE];
+  int fd;
+
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  if (read (fd, readbuf, TEST_SIZE) != TEST_SIZE)
+    fail ("read \"%s\" failed", file_name);
+  compare_bytes (readbuf, buf, TEST_SIZE, 0, file_name);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+}
+
+void
+test_main (void) 
+{
+  const char *file_name = "cached";
+  struct cache_stats before, after;
+  int fd;
+
+  random_bytes (buf, sizeof buf);
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  if (write (fd, buf, TEST_SIZE) != TEST_SIZE)
+    fail ("write \"%s\" failed", file_name);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+
+  read_file (file_name);
+
+  cache_stats (&before);
+  read_file (file_name);
+  cache_stats (&after);
+
+  if (after.misses != before.misses)
+    fail ("rereading \"%s\" caused %llu cache misses",
+          file_name, after.misses - before.misses);
+  if (after.hits <= before.hits)
+    fail ("rereading \"%s\" caused no cache hits", file_name);
+  msg ("reread hit in the cache");
+}
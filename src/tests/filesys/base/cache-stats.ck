@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(cache-stats) begin
+(cache-stats) create "cached"
+(cache-stats) open "cached"
+(cache-stats) close "cached"
+(cache-stats) open "cached"
+(cache-stats) close "cached"
+(cache-stats) open "cached"
+(cache-stats) close "cached"
+(cache-stats) reread hit in the cache
+(cache-stats) end
+EOF
+pass;
@@ -0,0 +1,23 @@
+/* Runs the page-merge-par and syn-read tests at the same time,
+   so that the swap traffic of the first and the file system
+   traffic of the second are in flight together.  The test is
+   run with the swap partition on a disk of its own on the
+   secondary IDE channel, so the two kinds of I/O can overlap;
+   the kernel reports how long both channels were busy at once
+   when it shuts down. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  pid_t merge_pid, read_pid;
+
+  CHECK ((merge_pid = exec ("page-merge-par")) != -1, "exec \"page-merge-par\"");
+  CHECK ((read_pid = exec ("syn-read")) != -1, "exec \"syn-read\"");
+
+  CHECK (wait (merge_pid) == 0, "wait for page-merge-par");
+  CHECK (wait (read_pid) == 0, "wait for syn-read");
+}
@@ -0,0 +1,90 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+
+# The two tests run at the same time, so their output lines
+# interleave in any order.  Check each test's own lines, in
+# order, separately.
+my (%expected);
+$expected{'io-overlap'} = <<'EOF';
+(io-overlap) begin
+(io-overlap) exec "page-merge-par"
+(io-overlap) exec "syn-read"
+(io-overlap) wait for page-merge-par
+(io-overlap) wait for syn-read
+(io-overlap) end
+EOF
+$expected{'page-merge-par'} = <<'EOF';
+(page-merge-par) begin
+(page-merge-par) init
+(page-merge-par) sort chunk 0
+(page-merge-par) sort chunk 1
+(page-merge-par) sort chunk 2
+(page-merge-par) sort chunk 3
+(page-merge-par) sort chunk 4
+(page-merge-par) sort chunk 5
+(page-merge-par) sort chunk 6
+(page-merge-par) sort chunk 7
+(page-merge-par) wait for child 0
+(page-merge-par) wait for child 1
+(page-merge-par) wait for child 2
+(page-merge-par) wait for child 3
+(page-merge-par) wait for child 4
+(page-merge-par) wait for child 5
+(page-merge-par) wait for child 6
+(page-merge-par) wait for child 7
+(page-merge-par) merge
+(page-merge-par) verify
+(page-merge-par) success, buf_idx=1,048,576
+(page-merge-par) end
+EOF
+$expected{'syn-read'} = <<'EOF';
+(syn-read) begin
+(syn-read) create "data"
+(syn-read) open "data"
+(syn-read) write "data"
+(syn-read) close "data"
+(syn-read) exec child 1 of 10: "child-syn-read 0"
+(syn-read) exec child 2 of 10: "child-syn-read 1"
+(syn-read) exec child 3 of 10: "child-syn-read 2"
+(syn-read) exec child 4 of 10: "child-syn-read 3"
+(syn-read) exec child 5 of 10: "child-syn-read 4"
+(syn-read) exec child 6 of 10: "child-syn-read 5"
+(syn-read) exec child 7 of 10: "child-syn-read 6"
+(syn-read) exec child 8 of 10: "child-syn-read 7"
+(syn-read) exec child 9 of 10: "child-syn-read 8"
+(syn-read) exec child 10 of 10: "child-syn-read 9"
+(syn-read) wait for child 1 of 10 returned 0 (expected 0)
+(syn-read) wait for child 2 of 10 returned 1 (expected 1)
+(syn-read) wait for child 3 of 10 returned 2 (expected 2)
+(syn-read) wait for child 4 of 10 returned 3 (expected 3)
+(syn-read) wait for child 5 of 10 returned 4 (expected 4)
+(syn-read) wait for child 6 of 10 returned 5 (expected 5)
+(syn-read) wait for child 7 of 10 returned 6 (expected 6)
+(syn-read) wait for child 8 of 10 returned 7 (expected 7)
+(syn-read) wait for child 9 of 10 returned 8 (expected 8)
+(syn-read) wait for child 10 of 10 returned 9 (expected 9)
+(syn-read) end
+EOF
+
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+my (@core) = get_core_output ("run", @output);
+my ($overlap) = map (/^ide: both channels busy for (\d+) ticks$/,
+                     @output);
+fail "ide_print_stats() did not report the channels' overlap.\n"
+  if !defined $overlap;
+fail "Swap and file system I/O never kept both IDE channels busy "
+  . "at once.\n"
+  if $overlap <= 0;
+for my $name (sort keys %expected) {
+    my (@actual) = grep (/^\(\Q$name\E\) /, @core);
+    my (@wanted) = split ("\n", $expected{$name});
+    next if join ("\n", @actual) eq join ("\n", @wanted);
+    fail "Output of $name failed to match.\n\n"
+      . "Expected:\n" . join ('', map ("  $_\n", @wanted))
+      . "Actual:\n" . join ('', map ("  $_\n", @actual));
+}
+pass;
@@ -0,0 +1,60 @@
+/* Measures how many cycles a page fault takes.  Touches each
+   page of a zero-filled array once, so that every access
+   faults the page in, and then touches every page again with
+   all of them present, as a baseline.  The kernel should
+   handle each fault in a bounded number of steps, so the
+   average is reported but not checked. */
+
+#include <stdint.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 64
+
+static char buf[PAGE_CNT][PAGE_SIZE] __attribute__ ((aligned (PAGE_SIZE)));
+
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t t;
+  asm volatile ("rdtsc" : "=A" (t));
+  return t;
+}
+
+/* Writes to the first byte of each page of BUF and returns
+   the total number of cycles the writes took. */
+static uint64_t
+touch_pages (char value)
+{
+  uint64_t total = 0;
+  size_t i;
+
+  for (i = 0; i < PAGE_CNT; i++)
+    {
+      uint64_t start = rdtsc ();
+      buf[i][0] = value;
+      total += rdtsc () - start;
+    }
+  return total;
+}
+
+void
+test_main (void)
+{
+  uint64_t fault_cycles, present_cycles;
+  size_t i;
+
+  fault_cycles = touch_pages (1);
+  present_cycles = touch_pages (2);
+
+  for (i = 0; i < PAGE_CNT; i++)
+    if (buf[i][0] != 2 || buf[i][1] != 0)
+      fail ("byte 0 of page %zu is %d, byte 1 is %d",
+            i, buf[i][0], buf[i][1]);
+
+  msg ("faulting access: %llu cycles on average",
+       fault_cycles / PAGE_CNT);
+  msg ("present access: %llu cycles on average",
+       present_cycles / PAGE_CNT);
+}
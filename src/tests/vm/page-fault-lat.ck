@@ -0,0 +1,39 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+
+# Cycle counts depend on the machine and the simulator, so
+# they are replaced by N before the output is compared.
+my ($expected) = <<'EOF';
+(page-fault-lat) begin
+(page-fault-lat) faulting access: N cycles on average
+(page-fault-lat) present access: N cycles on average
+(page-fault-lat) end
+EOF
+
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+my (@actual) = get_core_output ("run", @output);
+s/: \d+ cycles/: N cycles/ foreach @actual;
+my (@wanted) = split ("\n", $expected);
+fail "Output failed to match.\n\n"
+  . "Expected:\n" . join ('', map ("  $_\n", @wanted))
+  . "Actual:\n" . join ('', map ("  $_\n", @actual))
+  if join ("\n", @actual) ne join ("\n", @wanted);
+
+# A fault must cost more than touching a present page, but a
+# minor fault that allocates nothing and does no I/O should stay
+# far below a disk access even in a slow simulator.
+my ($fault, $present);
+foreach (get_core_output ("run", @output)) {
+    $fault = $1 if /faulting access: (\d+) cycles/;
+    $present = $1 if /present access: (\d+) cycles/;
+}
+fail "faulting access ($fault cycles) was not slower than "
+  . "present access ($present cycles)\n"
+  if $fault <= $present;
+fail "faulting access took $fault cycles, more than 10000000\n"
+  if $fault > 10000000;
+pass;
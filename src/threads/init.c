@@ -40,6 +40,7 @@
 #include "devices/ide.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
+#include "filesys/cache.h"
 #endif
 
 /* Page directory with kernel mappings only. */
@@ -135,6 +136,7 @@ main (void)
 #endif
 
 #ifdef VM
+  vm_frame_start();
   vm_swapsys_init();
 #endif
 
@@ -258,9 +260,24 @@ parse_options (char **argv)
         filesys_bdev_name = value;
       else if (!strcmp (name, "-scratch"))
         scratch_bdev_name = value;
+      else if (!strcmp (name, "-cache"))
+        {
+          if (value == NULL || !buffer_cache_set_size (atoi (value)))
+            PANIC ("invalid buffer cache size `%s' (use -h for help)", value);
+        }
+      else if (!strcmp (name, "-cache-policy"))
+        {
+          if (value == NULL || !buffer_cache_set_policy (value))
+            PANIC ("unknown buffer cache policy `%s' (use -h for help)", value);
+        }
 #ifdef VM
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
+      else if (!strcmp (name, "-vm-policy"))
+        {
+          if (value == NULL || !vm_frame_set_policy (value))
+            PANIC ("unknown page replacement policy `%s' (use -h for help)", value);
+        }
 #endif
 #endif
       else if (!strcmp (name, "-rs"))
@@ -387,8 +404,14 @@ usage (void)
           "  -f                 Format file system device during startup.\n"
           "  -filesys=BDEV      Use BDEV for file system instead of default.\n"
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
+          "  -cache=SECTORS     Use a SECTORS-sector buffer cache instead of\n"
+          "                     sizing it to 1/64 of RAM.\n"
+          "  -cache-policy=NAME Use buffer cache replacement policy NAME\n"
+          "                     (clock, the default, or 2q).\n"
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
+          "  -vm-policy=NAME    Use page replacement policy NAME\n"
+          "                     (clock, the default, or wsclock).\n"
 #endif
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
@@ -513,6 +513,7 @@ init_thread (struct thread *t, const char *name, int priority)
   t->parent_thread = running_thread();
 #ifdef VM
   memset(t->mmap_d, NULL, sizeof(struct mmap_descriptor*) * 128);
+  t->exec_file = NULL;
 #endif
 
   /* pintos manual: recent_cpu, nice는 부모 thread로 부터 상속된 값을 가진다. */
@@ -140,6 +140,7 @@ struct thread
 #ifdef VM
     struct hash spt;
     struct mmap_descriptor* mmap_d[128];
+    struct file* exec_file;             /* 실행 파일. 코드와 데이터 page를 처음 접근할 때 여기서 읽어온다. */
 #endif
     struct dir *cwd;
     struct thread* parent_thread;
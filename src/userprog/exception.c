@@ -126,9 +126,7 @@ static bool grow_user_stack(void* faulted_page){
     PANIC("install_page 에러");
     exit(-1);
   }
-  struct vm_ft_same_keys * founds = vm_frame_lookup_same_keys(kernel_virtual_page_in_user_pool);
-  vm_frame_setting_over(founds);
-  vm_ft_same_keys_free(founds);
+  vm_frame_setting_over(kernel_virtual_page_in_user_pool);
 
   return true;
 }
@@ -222,12 +220,19 @@ page_fault (struct intr_frame *f)
      and thereby frees all of its resources. */
   struct supplemental_page_table_entry* spte = vm_spt_lookup(&t->spt, faulted_user_page);
   if(spte != NULL && !is_kernel_vaddr(faulted_user_page) && (not_present || !write)){
+    /* 다른 thread가 이 page를 evict하는 중이다. 기록이 끝나기를 기다린 뒤 다시 올려둔다. */
+    if(spte->frame_data_clue == IN_FRAME)
+      vm_frame_wait_for_eviction(spte);
+
     //Call handle_mm_fault
     if(spte->frame_data_clue == IN_SWAP && vm_load_IN_SWAP_to_user_pool(spte)){
       //Restart process
-      struct vm_ft_same_keys * founds = vm_frame_lookup_same_keys(spte->kernel_virtual_page_in_user_pool);
-      vm_frame_setting_over(founds);
-      vm_ft_same_keys_free(founds);
+      vm_frame_setting_over(spte->kernel_virtual_page_in_user_pool);
+      return;
+    }
+    if(spte->frame_data_clue == SAME_FILLED && vm_load_SAME_FILLED_to_user_pool(spte)){
+      //Restart process
+      vm_frame_setting_over(spte->kernel_virtual_page_in_user_pool);
       return;
     }
     if(spte->frame_data_clue == IN_FILE && vm_load_IN_FILE_to_user_pool(spte)){
@@ -235,9 +240,7 @@ page_fault (struct intr_frame *f)
       //install_page()때와 마찬가지로 설치했을때는 꺼준다.
       pagedir_set_dirty (t->pagedir, spte->kernel_virtual_page_in_user_pool, false);
       //Restart process
-      struct vm_ft_same_keys * founds = vm_frame_lookup_same_keys(spte->kernel_virtual_page_in_user_pool);
-      vm_frame_setting_over(founds);
-      vm_ft_same_keys_free(founds);
+      vm_frame_setting_over(spte->kernel_virtual_page_in_user_pool);
       return;
     }
 
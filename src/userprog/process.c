@@ -170,6 +170,9 @@ process_exit (void)
 #ifdef VM
   /* spt 메모리 해제 (implement later) */
   vm_spt_destroy(&cur->spt);
+  /* 더 이상 page를 읽어올 일이 없으므로 실행 파일을 닫는다. 닫으면 다시 쓸 수 있게 된다. */
+  file_close(cur->exec_file);
+  cur->exec_file = NULL;
 #endif
 
   /* Destroy the current process's page directory and switch back
@@ -410,7 +413,19 @@ load (const char *file_name, void (**eip) (void), void **esp)
 
  done:
   /* We arrive here whether the load is successful or not. */
+#ifdef VM
+  /* 코드와 데이터 page는 page fault에서 읽어오므로 프로세스가 끝날 때까지 열어둔다.
+     그동안 내용이 바뀌지 않도록 쓰기를 막는다. */
+  if (success)
+    {
+      file_deny_write (file);
+      t->exec_file = file;
+    }
+  else
+    file_close (file);
+#else
   file_close (file);
+#endif
   return success;
 }
 static void construct_stack(const char* file_name, void** esp){
@@ -541,6 +556,29 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (ofs % PGSIZE == 0);
 
+#ifdef VM
+  /* 각 page를 IN_FILE로 spt에 등록만 해둔다. 처음 접근할 때 page fault에서
+     vm_load_IN_FILE_to_user_pool()이 읽어오므로, 접근하지 않는 page는 frame을 차지하지 않는다. */
+  struct thread *t = thread_current ();
+  while (read_bytes > 0 || zero_bytes > 0) 
+    {
+      size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
+      size_t page_zero_bytes = PGSIZE - page_read_bytes;
+
+      /* 다른 segment와 같은 page를 차지한다면 실패한다. (install_page()와 같다) */
+      if (vm_spt_lookup (&t->spt, upage) != NULL)
+        return false;
+      vm_spt_install_IN_FILE_page (&t->spt, upage, file, ofs,
+                                   page_read_bytes, page_zero_bytes, writable);
+
+      /* Advance. */
+      read_bytes -= page_read_bytes;
+      zero_bytes -= page_zero_bytes;
+      upage += PGSIZE;
+      ofs += page_read_bytes;
+    }
+  return true;
+#else
   file_seek (file, ofs);
   while (read_bytes > 0 || zero_bytes > 0) 
     {
@@ -550,58 +588,33 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
       size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
-      // 1. kernel virtual page(=frame)를 할당받는다.
       /* Get a page of memory. */
-      uint8_t *kpage = vm_frame_allocate (PAL_USER, upage);
+      uint8_t *kpage = palloc_get_page (PAL_USER);
       if (kpage == NULL)
         return false;
 
-      // 2. file의 내용을 읽어 kernel virtual page(=frame)에 쓴다.
       /* Load this page. */
       if (file_read (file, kpage, page_read_bytes) != (int) page_read_bytes)
         {
-#ifdef VM
-          struct supplemental_page_table_entry key;
-          key.kernel_virtual_page_in_user_pool = kpage;
-          key.user_page = upage;
-          struct frame_table_entry* fte = vm_frame_lookup_exactly_identical(&key);
-          vm_frame_free(fte);
-#else
-          palloc_free_page(kpage);
-#endif
+          palloc_free_page (kpage);
           return false; 
         }
       memset (kpage + page_read_bytes, 0, page_zero_bytes);
 
-      // 3. upage의 logical address로 page-directory -> page-table을 따라 찾아가면 나오는 pte에
-      //    kpage(frame)을 연관시킨다.
       /* Add the page to the process's address space. */
       if (!install_page (upage, kpage, writable)) 
         {
-#ifdef VM
-          struct supplemental_page_table_entry key;
-          key.kernel_virtual_page_in_user_pool = kpage;
-          key.user_page = upage;
-          struct frame_table_entry* fte = vm_frame_lookup_exactly_identical(&key);
-          vm_frame_free(fte);
-#else
-          palloc_free_page(kpage);
-#endif
+          palloc_free_page (kpage);
           return false; 
         }
 
-#ifdef VM
-      struct vm_ft_same_keys * founds = vm_frame_lookup_same_keys(kpage);
-      vm_frame_setting_over(founds);
-      vm_ft_same_keys_free(founds);
-#endif
-
       /* Advance. */
       read_bytes -= page_read_bytes;
       zero_bytes -= page_zero_bytes;
       upage += PGSIZE;
     }
   return true;
+#endif
 }
 
 /* Create a minimal stack by mapping a zeroed page at the top of
@@ -625,9 +638,7 @@ setup_stack (void **esp)
       if (success){
         *esp = PHYS_BASE;
 #ifdef VM
-        struct vm_ft_same_keys * founds = vm_frame_lookup_same_keys(kpage);
-        vm_frame_setting_over(founds);
-        vm_ft_same_keys_free(founds);
+        vm_frame_setting_over(kpage);
 #endif
       }
       else{
@@ -347,6 +347,11 @@ int inumber(int fd)
   return (int)inode_get_inumber (t->fd[fd]->file->inode);
 }
 
+void cache_stats(struct cache_stats *stats)
+{
+  buffer_cache_get_stats(stats);
+}
+
 
 
 
@@ -776,6 +781,28 @@ syscall_handler (struct intr_frame *f UNUSED)
       break;
     }
 
+    case SYS_CACHE_STATS: {
+      if(!is_valid_user_provided_pointer(f->esp + 4, sizeof(uint32_t)))
+        exit(-1);
+      make_user_pointer_in_physical_memory(f->esp + 4, sizeof(uint32_t));
+
+      //통계를 적을 공간도 유효하고 writable해야 한다.
+      struct thread* t = thread_current();
+      struct cache_stats* stats = (struct cache_stats*)*(uint32_t *)(f->esp + 4);
+      if(!is_valid_user_provided_pointer(stats, sizeof *stats))
+        exit(-1);
+      if(!vm_spt_lookup(&t->spt, pg_round_down(stats))->writable
+       || !vm_spt_lookup(&t->spt, pg_round_down((uint8_t*)stats + sizeof *stats - 1))->writable)
+        exit(-1);
+      make_user_pointer_in_physical_memory(stats, sizeof *stats);
+
+      cache_stats(stats);
+
+      unmake(f->esp + 4, sizeof(uint32_t));
+      unmake(stats, sizeof *stats);
+      break;
+    }
+
   }
 
 }
@@ -77,5 +77,8 @@ bool readdir (int fd, char *name);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* buffer cache의 통계를 user가 준 stats에 복사한다. */
+void cache_stats (struct cache_stats *stats);
+
 
 #endif /* userprog/syscall.h */
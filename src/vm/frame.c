@@ -5,13 +5,17 @@
 #include "threads/thread.h"
 #include "userprog/pagedir.h"
 #include "threads/malloc.h"
-
-#include "vm/frame-table-hash.h"
+#include "devices/timer.h"
+#include "filesys/file.h"
+#include <hash.h>
+#include <list.h>
+#include <string.h>
 
 /* frame table은 user page를 저장하고 있는 frame에 대한 정보를 저장한다.
    즉, 모든 프레임들을 저장하지 않고, per system이다.
-   frame table entry를 빠르게 탐색할 수 있도록 해시테이블을 사용한다.
-   (key, value) = (frame, frame_table_entry)
+   frame table entry를 빠르게 탐색할 수 있도록 user pool의 frame 번호로 index하는 배열을 사용한다.
+   frame 번호는 kernel virtual page 주소에서 바로 계산되므로 page fault는 hash 탐색 없이 frame을 찾아간다.
+   (index, value) = (frame 번호, 그 frame을 사용하는 frame_table_entry들)
                                                         (unused) 0xFFFFFFFF ^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
 0x04000000 +----------------------------------+   <<------>>  0xC4000000 +----------------------------------+
            |                                  |   one-to one             |                                  |
@@ -34,28 +38,113 @@
          0 +----------------------------------+   <<------>>  0xC0000000 +----------------------------------+ PHYS_BASE
                                                         (user space) 0x0  vvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvv
               <PintOs Physical memory(64mb)>                                  <PintOs Virtual memory(4GB)> */
-static struct vm_ft_hash frame_table;
+/* user pool의 frame마다 하나씩 있는 frame descriptor.
+   frame 번호(pfn)로 바로 찾아갈 수 있는 배열 frame_array를 이룬다. frame_no() 참조.
+   page fault에서 hash를 찾거나 heap에서 할당하지 않고 frame을 찾아갈 수 있다. */
+struct frame{
+    /* 이 frame을 사용하는 fte들(struct frame_table_entry의 elem). 비어있다면 사용하지 않는 frame이다.
+       eviction의 clock hand가 이 배열을 돈다. */
+    struct list ftes;
+
+    /* evict되는 중이다. 사용하던 spte는 아직 IN_FRAME이지만 pagedir에서는 지워졌다. */
+    bool evicting;
+
+    /* evict하는 thread가 내용을 기록하는 동안 잡고 있는다. evict되는 page에 접근하려는 thread는
+       이 lock을 잡아서 기록이 끝나기를 기다린다. */
+    struct lock lock;
+
+    /* 실행 파일의 읽기 전용 page를 읽어둔 frame이라면 그 inode, offset과 읽어온 byte 수. shared_frames에 들어있어서
+       같은 실행 파일을 실행하는 다른 프로세스가 찾아와 함께 사용한다. 아니라면 shared_inode는 NULL이다.
+       두 segment가 파일의 같은 page를 서로 다른 read_bytes로 가리킬 수 있으므로(text의 끝과 rodata의 시작)
+       read_bytes까지 같아야 같은 내용이다. */
+    struct inode* shared_inode;
+    off_t shared_offset;
+    uint32_t shared_read_bytes;
+    struct hash_elem shared_elem;
+};
+static struct frame* frame_array;
+static uint8_t* user_pool_base;
+static size_t user_pool_frames;
+static size_t clock_hand;
+
+/* 교체 정책. insert와 select_victim은 frame_table_lock을 잡은 채로 호출된다.
+   -vm-policy=NAME 옵션으로 고를 수 있다. */
+struct frame_policy{
+  const char* name;
+  void (*init)(void);             /* vm_frame_init()에서 호출된다. */
+  void (*start)(void);            /* thread_start() 이후에 호출된다. */
+  void (*insert)(size_t no);      /* no번 frame이 새로 사용되기 시작했다. */
+  /* evict할 frame을 고른다. 없다면 NULL. */
+  struct frame* (*select_victim)(void);
+};
+
+static void frame_policy_nop(void);
+static void frame_policy_insert_nop(size_t no);
+static struct frame* clock_select_victim(void);
+
+static void wsclock_init(void);
+static void wsclock_start(void);
+static void wsclock_insert(size_t no);
+static struct frame* wsclock_select_victim(void);
+
+static const struct frame_policy clock_policy =
+  {"clock", frame_policy_nop, frame_policy_nop, frame_policy_insert_nop, clock_select_victim};
+static const struct frame_policy wsclock_policy =
+  {"wsclock", wsclock_init, wsclock_start, wsclock_insert, wsclock_select_victim};
+
+static const struct frame_policy* policies[] = {&clock_policy, &wsclock_policy};
+
+/* 사용중인 교체 정책. */
+static const struct frame_policy* policy = &clock_policy;
 
-/* reader-writers for frame_table
+/* WSClock: aging thread가 WSCLOCK_AGING_INTERVAL tick마다 모든 frame의 access bit를 모아
+   frame_ages를 오른쪽으로 밀고 접근되었다면 최상위 bit를 켠다(aging).
+   마지막으로 접근된 것이 관측된 시각은 frame_last_use에 기록한다.
+   그보다 WSCLOCK_WINDOW tick 이상 지난 frame은 working set을 벗어났다고 본다. */
+#define WSCLOCK_AGING_INTERVAL (TIMER_FREQ / 10)
+#define WSCLOCK_WINDOW (TIMER_FREQ / 2)
+static uint8_t* frame_ages;
+static int64_t* frame_last_use;
+
+/* frame_array, fte slab, clock hand와 교체 정책의 상태, fte의 is_used_for_user_pointer와 setting_now,
+   그리고 evict되는 page의 spte 갱신을 보호한다.
 
    x frame을 swap out이 안되게 고정하는 도중에 x frame이 swap out이 일어나면 안된다.
-   frame number을 이용한 배열을 만들어서 frame 마다 lock을 잡으면 성능상 더 빠를수도 있다.
-   그러나 시간상의 문제로 이는 구현하지 않는다. 대신 frame_table_w를 사용한다. */
-static struct semaphore frame_table_w;
-static int read_cnt;
-static struct lock mutex;
+   그러나 swap device에 기록하는 동안 이 lock을 잡고 있으면 다른 모든 page fault가 기다리게 된다.
+   따라서 이 lock은 짧게만 잡고 I/O를 하는 동안에는 절대 잡지 않는다.
+   기록하는 동안에는 evict되는 frame의 lock(struct frame)만 잡는다.
+
+   lock 순서: frame_table_lock -> struct frame의 lock -> swap.c의 lock */
+static struct lock frame_table_lock;
+
+/* frame_table_lock과 함께 사용한다. 진행중인 eviction이 끝나거나, frame이 free되거나,
+   frame의 고정(setting_now, is_used_for_user_pointer)이 풀릴 때마다 broadcast되고 frame_events가 늘어난다.
+   빈 frame도 고를 수 있는 frame도 없을 때 이 중 하나가 일어나기를 기다린다. */
+static struct condition eviction_done;
+static unsigned frame_events;
+
+/* fte를 위한 slab. palloc에서 받은 kernel page를 fte 크기로 잘라 fte_free_list에 두고 꺼내 쓴다.
+   frame마다 하나씩은 vm_frame_init()에서 미리 만들어두므로 page fault에서는 heap 할당을 하지 않는다.
+   slab page는 user pool sharing으로 fte가 모자랄 때만 늘어나고 돌려주지 않는다. */
+static struct list fte_free_list;
 
+static size_t frame_no(void* kernel_virtual_page_in_user_pool);
+static void fte_slab_grow(void);
+static void vm_add_fte(void* kernel_virtual_page_in_user_pool, void* user_page);
+static void frame_event_locked(void);
 
-static unsigned frame_table_hash_func(const struct vm_ft_hash_elem* e, void* aux);
-static bool frame_table_less_func(const struct vm_ft_hash_elem* a, const struct vm_ft_hash_elem* b, void* aux);
-static bool frame_table_value_less_func(const struct vm_ft_hash_elem*a, const struct vm_ft_hash_elem*b, void *aux);
+/* 여러 프로세스가 함께 사용할 수 있는 frame들. (key, value) = ((inode, offset, read_bytes), frame)
+   frame_table_lock으로 보호한다. */
+static struct hash shared_frames;
+static unsigned shared_frame_hash_func(const struct hash_elem* elem, void* aux);
+static bool shared_frame_less_func(const struct hash_elem* a, const struct hash_elem* b, void* aux);
 
 
 struct frame_table_entry{
     /* 이 엔트리가 나타내는 frame을 kernel_virtual_page에 virtual address로 저장한다.
        이것이 가능한 이유는 PintOs는 64MB-Physical-memory를 vitual memory의 kernel space에 전부 1:1 매핑하기 때문이다.
        (user space는 page directory를 이용해 frame을 찾아갈 것이다.)
-       
+
        (In PintOs) kernel space of virtual memory는
        physical memory에 완벽히 1:1 대응되어 매핑된다. 즉, 이 변수가 frame이라 여기면 된다.
        kernel page of virtual memory 주소를 저장한다. */
@@ -63,7 +152,7 @@ struct frame_table_entry{
 
     void* user_page;            /* kernel_virtual_page가 저장하는 user_page의 주소. alias. */
 
-    struct vm_ft_hash_elem elem;      /* see ::frame_table */
+    struct list_elem elem;      /* struct frame의 ftes. 사용하지 않는 fte라면 fte_free_list. */
 
     struct thread *t;           /* 이 엔트리와 연관된 thread */
 
@@ -71,161 +160,499 @@ struct frame_table_entry{
        The frame table allows Pintos to efficiently implement an eviction
        policy, by choosing a page to evict when no frames are free.
        This variable is one of the reason why frame table exists!!
-       
-       4.3.5) eviction 구현 이후, User pointer가 커널 코드에 의해 액세스 되는 동안에도 evict되어 
+
+       4.3.5) eviction 구현 이후, User pointer가 커널 코드에 의해 액세스 되는 동안에도 evict되어
        kernel 모드에서 page fault가 발생한다. 커널은 “page fault를 해결하는데 필요한 리소스를 보유하고 있는 동안”
        에는 이 page fault를 방지해야한다.
 
-       page fault를 해결하는데 필요한 리소스에는 device driver가 보유한 lock같은 것이 있다. 
+       page fault를 해결하는데 필요한 리소스에는 device driver가 보유한 lock같은 것이 있다.
        device driver는 swap device, fs device를 컨트롤하는 역할을 한다.
        (page fault에서 file_read, file_write로 swap device와 데이터를 주고받는 것을 볼 수 있다)
 
-       즉, 커널이 read, write syscall로 file_read, file_write로 fs device와 데이터를 주고받을때 
+       즉, 커널이 read, write syscall로 file_read, file_write로 fs device와 데이터를 주고받을때
        커널은 page fault를 해결하는데 필요한 리소스를 보유하고 있다. 이때 page fault를 방지해야한다. */
     int is_used_for_user_pointer;
 
     bool setting_now;
 };
 
+/* 한 slab page에 들어가는 fte의 개수 */
+#define FTES_PER_SLAB (PGSIZE / sizeof(struct frame_table_entry))
+
 
 
 void vm_frame_init(){
-  lock_init(&mutex);
-  sema_init(&frame_table_w, 1);
-  read_cnt = 0;
+  lock_init(&frame_table_lock);
+  cond_init(&eviction_done);
+  frame_events = 0;
+
+  void* base;
+  palloc_user_pool_range(&base, &user_pool_frames);
+  user_pool_base = base;
+  frame_array = calloc(user_pool_frames, sizeof *frame_array);
+  if(frame_array == NULL)
+    PANIC("frame_array creation failed");
+  for(size_t i = 0; i < user_pool_frames; ++i){
+    list_init(&frame_array[i].ftes);
+    lock_init(&frame_array[i].lock);
+  }
+  clock_hand = 0;
+
+  hash_init(&shared_frames, shared_frame_hash_func, shared_frame_less_func, NULL);
+
+  list_init(&fte_free_list);
+  for(size_t i = 0; i < user_pool_frames; i += FTES_PER_SLAB)
+    fte_slab_grow();
+
+  policy->init();
+}
+
+/* thread_start() 이후에 호출한다. 교체 정책이 필요로 하는 kernel thread를 시작한다. */
+void vm_frame_start(void){
+  policy->start();
+}
+
+/* 교체 정책을 NAME으로 바꾼다. vm_frame_init() 전에 호출해야 한다.
+   NAME에 해당하는 정책이 없다면 false를 반환한다. */
+bool vm_frame_set_policy(const char* name){
+  for(size_t i = 0; i < sizeof policies / sizeof *policies; ++i){
+    if(!strcmp(policies[i]->name, name)){
+      policy = policies[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+
+/* slab page 하나를 받아 fte_free_list에 넣는다. */
+static void fte_slab_grow(void){
+  struct frame_table_entry* slab = palloc_get_page(0);
+  if(slab == NULL)
+    PANIC("fte slab creation failed");
+  for(size_t i = 0; i < FTES_PER_SLAB; ++i)
+    list_push_back(&fte_free_list, &slab[i].elem);
+}
+
+/* fte를 하나 꺼낸다. frame_table_lock을 잡은 채로 호출한다. */
+static struct frame_table_entry* fte_alloc(void){
+  if(list_empty(&fte_free_list))
+    fte_slab_grow();
+  return list_entry(list_pop_front(&fte_free_list), struct frame_table_entry, elem);
+}
+
+/* fte를 frame에서 떼어 slab에 돌려준다. frame_table_lock을 잡은 채로 호출한다. */
+static void fte_free(struct frame_table_entry* fte){
+  list_remove(&fte->elem);
+  list_push_front(&fte_free_list, &fte->elem);
+}
 
-  vm_ft_hash_init(&frame_table, frame_table_hash_func, frame_table_less_func, frame_table_value_less_func, NULL);
+
+/* frame에서 thread t의 user_page를 나타내는 fte를 찾는다. 없다면 NULL. */
+static struct frame_table_entry* frame_find_fte(struct frame* f, struct thread* t, void* user_page){
+  struct list_elem* e;
+  for(e = list_begin(&f->ftes); e != list_end(&f->ftes); e = list_next(e)){
+    struct frame_table_entry* fte = list_entry(e, struct frame_table_entry, elem);
+    if(fte->t == t && fte->user_page == user_page)
+      return fte;
+  }
+  return NULL;
+}
+
+
+/* frame을 shared_frames에서 뺀다. 더 이상 다른 프로세스가 찾아와 사용하지 않는다.
+   frame_table_lock을 잡은 채로 호출한다. */
+static void frame_unshare(struct frame* f){
+  if(f->shared_inode != NULL){
+    hash_delete(&shared_frames, &f->shared_elem);
+    f->shared_inode = NULL;
+  }
+}
+
+/* 같은 실행 파일의 spte와 같은 위치를 다른 프로세스가 이미 frame에 읽어두었다면
+   그 frame을 현재 thread의 spte의 user page로도 사용한다고 frame table에 기록한다.
+   frame의 kernel virtual page를 반환한다. 없다면 NULL을 반환한다.
+   vm_frame_allocate()와 마찬가지로 vm_frame_setting_over() 전까지 evict되지 않는다. */
+void* vm_frame_share_lookup(struct supplemental_page_table_entry* spte){
+  ASSERT(spte->frame_data_clue == IN_FILE && !spte->writable);
+
+  struct frame key;
+  key.shared_inode = file_get_inode(spte->file);
+  key.shared_offset = spte->file_offset;
+  key.shared_read_bytes = spte->read_bytes;
+
+  void* kernel_virtual_page_in_user_pool = NULL;
+  lock_acquire(&frame_table_lock);
+  struct hash_elem* e = hash_find(&shared_frames, &key.shared_elem);
+  if(e != NULL){
+    struct frame* f = hash_entry(e, struct frame, shared_elem);
+    kernel_virtual_page_in_user_pool = user_pool_base + (f - frame_array) * PGSIZE;
+    vm_add_fte(kernel_virtual_page_in_user_pool, spte->user_page);
+  }
+  lock_release(&frame_table_lock);
+  return kernel_virtual_page_in_user_pool;
 }
 
-/* 이 함수 사용후 반환값을 vm_ft_same_keys_free를 통해 해제해야 한다. */
-struct vm_ft_same_keys* vm_frame_lookup_same_keys(void* kernel_virtual_page_in_user_pool){
-  lock_acquire(&mutex);
-  ++read_cnt;
-  if(read_cnt == 1)
-    sema_down(&frame_table_w);
-  lock_release(&mutex);
+/* 실행 파일의 읽기 전용 page인 spte를 막 읽어온 frame을 다른 프로세스들이 함께 사용할 수 있게 등록한다.
+   다른 프로세스가 같은 위치를 먼저 등록했다면 이 frame은 등록하지 않는다. */
+void vm_frame_share_register(struct supplemental_page_table_entry* spte){
+  ASSERT(spte->frame_data_clue == IN_FRAME && !spte->writable);
+
+  lock_acquire(&frame_table_lock);
+  struct frame* f = &frame_array[frame_no(spte->kernel_virtual_page_in_user_pool)];
+  ASSERT(f->shared_inode == NULL);
+  f->shared_inode = file_get_inode(spte->file);
+  f->shared_offset = spte->file_offset;
+  f->shared_read_bytes = spte->read_bytes;
+  if(hash_insert(&shared_frames, &f->shared_elem) != NULL)
+    f->shared_inode = NULL;
+  lock_release(&frame_table_lock);
+}
 
-  struct frame_table_entry key;
-  key.kernel_virtual_page_in_user_pool = kernel_virtual_page_in_user_pool;
-  struct vm_ft_same_keys* founds = vm_ft_hash_find_same_keys(&frame_table, &(key.elem));
 
-  lock_acquire(&mutex);
-  --read_cnt;
-  if(read_cnt == 0)
-    sema_up(&frame_table_w);
-  lock_release(&mutex);
-  return founds;
+/* kernel_virtual_page가 user pool의 frame이라면 true를 반환한다.
+   user pool의 frame은 frame table만이 deallocate한다. use in pagedir.c:pagedir_destroy() */
+bool vm_frame_in_user_pool(void* kernel_virtual_page){
+  return (uint8_t*)kernel_virtual_page >= user_pool_base
+         && (uint8_t*)kernel_virtual_page < user_pool_base + user_pool_frames * PGSIZE;
 }
 
 
-/* 정확히 spte의 내용과 일치하는 frame_table_entry 하나를 반환한다. */
+/* 정확히 spte의 내용과 일치하는 현재 thread의 frame_table_entry 하나를 반환한다. */
 struct frame_table_entry* vm_frame_lookup_exactly_identical(struct supplemental_page_table_entry* spte){
-  lock_acquire(&mutex);
-  ++read_cnt;
-  if(read_cnt == 1)
-    sema_down(&frame_table_w);
-  lock_release(&mutex);
+  lock_acquire(&frame_table_lock);
 
   ASSERT(spte->frame_data_clue == IN_FRAME);
-  struct frame_table_entry key;
-  key.kernel_virtual_page_in_user_pool = spte->kernel_virtual_page_in_user_pool;
-  key.user_page = spte->user_page;
-  struct vm_ft_hash_elem* e = vm_ft_hash_find_exactly_identical(&frame_table, &(key.elem));
-  struct frame_table_entry* ret = vm_ft_hash_entry(e, struct frame_table_entry, elem);
-
-  lock_acquire(&mutex);
-  --read_cnt;
-  if(read_cnt == 0)
-    sema_up(&frame_table_w);
-  lock_release(&mutex);
+  struct frame* f = &frame_array[frame_no(spte->kernel_virtual_page_in_user_pool)];
+  struct frame_table_entry* ret = frame_find_fte(f, thread_current(), spte->user_page);
+  ASSERT(ret != NULL);
+
+  lock_release(&frame_table_lock);
   return ret;
 }
 
 
-static bool can_be_evicted(struct vm_ft_same_keys* founds){
-  for(int i = 0; i < founds->len; ++i){
-      struct frame_table_entry *e = vm_ft_hash_entry(founds->pointers_arr_of_ft_hash_elem[i], struct frame_table_entry, elem);
-      if(e->is_used_for_user_pointer > 0 || e->setting_now)
+/* frame_table_lock을 잡은 채로 호출한다.
+   spte의 page가 evict되는 중이라면 frame_table_lock을 놓고 그 frame의 lock에서 기록이 끝나기를 기다린다.
+   반환할 때는 다시 frame_table_lock을 잡고 있고, spte는 frame에 온전히 있거나(IN_FRAME) evict가 끝난 상태이다. */
+static void wait_for_eviction_locked(struct supplemental_page_table_entry* spte){
+  ASSERT(lock_held_by_current_thread(&frame_table_lock));
+  while(spte->frame_data_clue == IN_FRAME){
+    struct frame* f = &frame_array[frame_no(spte->kernel_virtual_page_in_user_pool)];
+    if(!f->evicting)
+      return;
+    lock_release(&frame_table_lock);
+    lock_acquire(&f->lock);
+    lock_release(&f->lock);
+    lock_acquire(&frame_table_lock);
+  }
+}
+
+/* spte가 IN_FRAME이지만 pagedir에 없다면 다른 thread가 evict하는 중이다. 끝나기를 기다린다.
+   반환한 뒤 spte는 frame에 있거나 IN_SWAP, SAME_FILLED 상태이다. use in exception.c */
+void vm_frame_wait_for_eviction(struct supplemental_page_table_entry* spte){
+  lock_acquire(&frame_table_lock);
+  wait_for_eviction_locked(spte);
+  lock_release(&frame_table_lock);
+}
+
+
+static bool can_be_evicted(struct frame* f){
+  if(f->evicting)
+    return false;
+  struct list_elem* e;
+  for(e = list_begin(&f->ftes); e != list_end(&f->ftes); e = list_next(e)){
+      struct frame_table_entry *fte = list_entry(e, struct frame_table_entry, elem);
+      if(fte->is_used_for_user_pointer > 0 || fte->setting_now)
         return false;
   }
   return true;
 }
 
 
-/* random frame replacement algorithm
-   user pointer로 참조되는 frame이 아닌 다른 frame을 아무거나 하나 골라서 반환한다. */
-static uint32_t next = 1;
-static struct vm_ft_same_keys* pick_frame_to_evict(void){
-  size_t n = vm_ft_hash_size(&frame_table);
+/* frame을 사용하는 fte 중 하나라도 user page나 kernel alias로 접근되었다면 true를 반환하고 access bit를 끈다. */
+static bool test_and_clear_accessed(struct frame* f){
+  bool accessed = false;
+  struct list_elem* e;
+  for(e = list_begin(&f->ftes); e != list_end(&f->ftes); e = list_next(e)){
+    struct frame_table_entry* fte = list_entry(e, struct frame_table_entry, elem);
+    uint32_t* pd = fte->t->pagedir;
+    if(pagedir_is_accessed(pd, fte->user_page) || pagedir_is_accessed(pd, fte->kernel_virtual_page_in_user_pool)){
+      accessed = true;
+      pagedir_set_accessed(pd, fte->user_page, false);
+      pagedir_set_accessed(pd, fte->kernel_virtual_page_in_user_pool, false);
+    }
+  }
+  return accessed;
+}
+
+/* frame을 사용하는 fte 중 하나라도 user page나 kernel alias로 수정되었다면 true를 반환한다. */
+static bool is_dirty(struct frame* f){
+  struct list_elem* e;
+  for(e = list_begin(&f->ftes); e != list_end(&f->ftes); e = list_next(e)){
+    struct frame_table_entry* fte = list_entry(e, struct frame_table_entry, elem);
+    uint32_t* pd = fte->t->pagedir;
+    if(pagedir_is_dirty(pd, fte->user_page) || pagedir_is_dirty(pd, fte->kernel_virtual_page_in_user_pool))
+      return true;
+  }
+  return false;
+}
 
-  while(true){
-    next = next*1103515245 + 12345;
-    size_t pointer = next % n;
 
-    struct vm_ft_hash_iterator it; 
-    vm_ft_hash_first(&it, &frame_table);
-    size_t i; for(i=0; i<=pointer; ++i) vm_ft_hash_next(&it);
+/* clock (enhanced second chance) frame replacement algorithm
+   clock hand로 frame_array를 돌면서 최근에 접근된 frame은 access bit를 끄고 한 번 더 기회를 준다.
+   접근되지 않았고 clean한 frame을 먼저 고른다. 접근되지 않았지만 dirty한 frame은 기억해두었다가,
+   한 바퀴를 도는 동안(모든 access bit가 한 번씩 꺼진다) clean한 frame이 없었다면 고른다.
+   user pointer로 참조되거나 설정중인 frame은 고르지 않는다.
 
-    struct vm_ft_same_keys* founds = vm_ft_hash_find_same_keys(&frame_table, vm_ft_hash_cur(&it));
-    ASSERT(founds != NULL);
-    if(can_be_evicted(founds))
-      return founds;
+   두 바퀴를 돌아도 고를 수 있는 frame이 없다면 NULL을 반환한다. */
+static struct frame* clock_select_victim(void){
+  struct frame* dirty_candidate = NULL;
+
+  for(size_t step = 0; step < 2 * user_pool_frames; ++step){
+    struct frame* f = &frame_array[clock_hand];
+    clock_hand = (clock_hand + 1) % user_pool_frames;
+
+    /* 한 바퀴를 돌았다. */
+    if(dirty_candidate != NULL && step >= user_pool_frames)
+      return dirty_candidate;
+
+    if(list_empty(&f->ftes) || !can_be_evicted(f) || test_and_clear_accessed(f))
+      continue;
+    if(!is_dirty(f))
+      return f;
+    if(dirty_candidate == NULL)
+      dirty_candidate = f;
   }
+  return dirty_candidate;
 }
 
 
-/* swap.c:vm_swap_out() */
-static void vm_evict_a_frame_to_swap_device(void){
-  struct vm_ft_same_keys* founds = pick_frame_to_evict();
-  //frame table에서 evict할 frame을 모두 없앤다.
-  struct vm_ft_same_keys* removed = vm_ft_hash_delete_same_keys (&frame_table, founds->pointers_arr_of_ft_hash_elem[0]);
-  vm_ft_same_keys_free(founds);
-
-  //내용을 swap devide에 기록한다.
-  struct frame_table_entry* one_of_removed = vm_ft_hash_entry(removed->pointers_arr_of_ft_hash_elem[0], struct frame_table_entry, elem);
-  size_t swap_idx = vm_swap_out(one_of_removed->kernel_virtual_page_in_user_pool, removed->len);
+/* WSClock frame replacement algorithm
+   clock과 같이 clock hand로 frame_array를 돌지만, 접근되지 않은 frame 중에서도
+   working set을 벗어났고(frame_last_use가 WSCLOCK_WINDOW보다 오래되었다) clean한 frame을 먼저 고른다.
+   그런 frame이 없다면 한 바퀴를 도는 동안 본 frame 중 가장 나은 것을 고른다.
+   working set을 벗어난 frame, clean한 frame, frame_ages가 작은(오래 접근되지 않은) frame 순으로 낫다. */
+static struct frame* wsclock_select_victim(void){
+  int64_t now = timer_ticks();
+  struct frame* candidate = NULL;
+  unsigned candidate_rank = 0;
+
+  for(size_t step = 0; step < 2 * user_pool_frames; ++step){
+    size_t i = clock_hand;
+    struct frame* f = &frame_array[i];
+    clock_hand = (clock_hand + 1) % user_pool_frames;
+
+    /* 한 바퀴를 돌았다. */
+    if(candidate != NULL && step >= user_pool_frames)
+      return candidate;
+
+    if(list_empty(&f->ftes) || !can_be_evicted(f))
+      continue;
+    if(test_and_clear_accessed(f)){
+      frame_ages[i] |= 0x80;
+      frame_last_use[i] = now;
+      continue;
+    }
+
+    bool old = now - frame_last_use[i] > WSCLOCK_WINDOW;
+    bool clean = !is_dirty(f);
+    if(old && clean)
+      return f;
+    /* 작을수록 낫다. */
+    unsigned rank = (!old) << 9 | (!clean) << 8 | frame_ages[i];
+    if(candidate == NULL || rank < candidate_rank){
+      candidate = f;
+      candidate_rank = rank;
+    }
+  }
+  return candidate;
+}
 
-  void* kpage = one_of_removed->kernel_virtual_page_in_user_pool;
+/* 교체 정책이 고른 victim을 반환한다. 고를 수 있는 frame이 없다면 NULL을 반환한다.
+   frame_table_lock을 잡은 채로 호출한다. */
+static struct frame* pick_frame_to_evict(void){
+  return policy->select_victim();
+}
 
-  for(int i = 0; i < removed->len; ++i){ //그러나 user pool sharing 구현은 없을 것
-    struct frame_table_entry* fte = vm_ft_hash_entry(removed->pointers_arr_of_ft_hash_elem[i], struct frame_table_entry, elem);
 
-    //fte의 정보와 일치하는 spte를 찾아서 갱신한다.
-    struct supplemental_page_table_entry* spte = vm_spt_lookup(&fte->t->spt, fte->user_page);
-    vm_spt_update_after_swap_out(spte, swap_idx);
+/* 한 번의 eviction에서 내보낼 frame의 최대 개수(low watermark).
+   user pool이 바닥나면 frame 하나만 비우지 않고 이만큼 비워서 이어지는 page fault들이
+   eviction 없이 바로 frame을 얻게 한다. 한 swap cluster 안에 들어가야한다. */
+#define EVICT_BATCH 8
+
+/* vm_evict_frames_to_swap_device()에서 swap device에 기록하지 않는 victim의 batch_pos. */
+#define EVICT_SAME_FILLED (-1)      /* 모든 word가 같은 값이다. */
+#define EVICT_SWAP_CACHED (-2)      /* clean하고 swap cache가 잡고 있는 slot에 같은 내용이 있다. */
+#define EVICT_FILE_BACKED (-3)      /* 실행 파일의 읽기 전용 page이다. */
+
+/* swap.c:vm_swap_out_batch()
+   최대 EVICT_BATCH개의 frame을 골라 swap device의 인접한 slot들에 한꺼번에 기록하고 user pool에 돌려준다.
+   모든 word가 같은 값인 frame은 swap slot도 disk I/O도 없이 spte에 그 값만 기록한다.
+   swap에서 읽어온 뒤 수정되지 않은 frame은 swap cache가 잡고 있던 slot을 그대로 다시 사용한다.
+
+   frame_table_lock은 victim을 고를 때와 spte를 갱신할 때만 잡는다. 기록하는 동안에는 victim들의 frame lock만
+   잡고 있으므로 다른 frame에 대한 page fault는 기다리지 않는다. victim의 fte들은 evicting인 frame에
+   남아있으므로 다시 골라지지 않는다.
+   고를 수 있는 frame이 하나도 없다면 palloc에 실패한 뒤(frame_events가 SEEN이던 때)로 frame이 free되거나
+   고정이 풀리지 않은 경우 그런 일이 일어나기를 기다린다. */
+static void vm_evict_frames_to_swap_device(unsigned seen){
+  struct frame* victims[EVICT_BATCH];
+  void* kpages[EVICT_BATCH];
+  uint32_t fill_values[EVICT_BATCH];
+  int batch_pos[EVICT_BATCH];           /* swap device에 기록한다면 아래 배열들에서의 위치, 아니면 EVICT_* */
+  void* swap_kpages[EVICT_BATCH];
+  int sharing_proc_nums[EVICT_BATCH];
+  size_t swap_idx[EVICT_BATCH];
+  struct block_request swap_requests[EVICT_BATCH];
+  size_t swap_cnt = 0;
+
+  lock_acquire(&frame_table_lock);
+
+  //evict할 frame들을 모두 evicting으로 표시한다. 표시한 frame은 다시 골라지지 않는다.
+  size_t n;
+  for(n = 0; n < EVICT_BATCH; ++n){
+    struct frame* f = pick_frame_to_evict();
+    if(f == NULL)
+      break;
+    size_t i = n;
+    victims[i] = f;
+    f->evicting = true;
+    lock_acquire(&f->lock);
+    frame_unshare(f);
+
+    struct frame_table_entry* one_of_ftes = list_entry(list_front(&f->ftes), struct frame_table_entry, elem);
+    kpages[i] = one_of_ftes->kernel_virtual_page_in_user_pool;
+
+    struct list_elem* e;
+    for(e = list_begin(&f->ftes); e != list_end(&f->ftes); e = list_next(e)){ //실행 파일의 읽기 전용 page라면 여러 프로세스가 공유한다.
+      struct frame_table_entry* fte = list_entry(e, struct frame_table_entry, elem);
+
+      /* alias문제가 발생한다. user data를 kernel space address를 통해서도 접근해왔으므로,
+         pagedir에 access bit, dirty bit가 서로 동기화되어있지 않다.
+         dirty bit는 swap cache와 mmap에서 정확한 정보가 필요하다.
+         둘중 하나라도 수정된 상황이면 수정했다고 여기고 수정했다는 정확한 정보를 user page에 저장한다. */
+      pagedir_set_dirty(fte->t->pagedir, fte->user_page
+        , pagedir_is_dirty(fte->t->pagedir, fte->user_page) || pagedir_is_dirty(fte->t->pagedir, fte->kernel_virtual_page_in_user_pool));
+      pagedir_set_dirty(fte->t->pagedir, fte->kernel_virtual_page_in_user_pool, false);
+
+      /* pagedir에서 present bit 갱신. 이제부터 이 page에 접근하면 page fault가 나고
+         vm_frame_wait_for_eviction()에서 기록이 끝나기를 기다린다. */
+      pagedir_clear_page(fte->t->pagedir, fte->user_page);
+    }
+    size_t sharing = list_size(&f->ftes);
+
+    /* 실행 파일의 읽기 전용 page는 수정될 수 없으므로 기록하지 않고 다시 실행 파일에서 읽어온다. */
+    struct thread* t = one_of_ftes->t;
+    struct supplemental_page_table_entry* spte = vm_spt_lookup(&t->spt, one_of_ftes->user_page);
+
+    /* swap에서 다시 읽어오면 swap slot과 같은 내용이므로 dirty bit를 끈다(swap cache).
+       file과 비교해서 수정되었다는 사실은 spte에 따로 기억해두어야 munmap에서 file에 기록한다. */
+    if(spte->file != NULL && pagedir_is_dirty(t->pagedir, spte->user_page))
+      spte->file_dirty = true;
+
+    if(spte->file != NULL && !spte->writable){
+      batch_pos[i] = EVICT_FILE_BACKED;
+      continue;
+    }
+
+    /* 읽어온 뒤 어느 alias로도 수정되지 않았다면 swap_slot의 내용이 그대로 유효하다. */
+    if(spte->swap_cached && sharing == 1 && !pagedir_is_dirty(t->pagedir, spte->user_page)){
+      batch_pos[i] = EVICT_SWAP_CACHED;
+      continue;
+    }
+    vm_spt_drop_swap_cache(spte);
+
+    if(vm_page_is_same_filled(kpages[i], &fill_values[i]))
+      batch_pos[i] = EVICT_SAME_FILLED;
+    else{
+      batch_pos[i] = swap_cnt;
+      swap_kpages[swap_cnt] = kpages[i];
+      sharing_proc_nums[swap_cnt] = sharing;
+      ++swap_cnt;
+    }
+  }
 
-    /* alias문제가 발생한다. user data를 kernel space address를 통해서도 접근해왔으므로,
-       pagedir에 access bit, dirty bit가 서로 동기화되어있지 않다.
-       access bit는 random evict algorithm을 적용했으므로 상관 쓸 필요가 없지만,
-       dirty bit는 mmap시 정확한 정보가 필요하다. 
-       둘중 하나라도 수정된 상황이면 수정했다고 여기고 수정했다는 정확한 정보를 저장한다. */
-    pagedir_set_dirty(fte->t->pagedir, fte->user_page
-      , pagedir_is_dirty(fte->t->pagedir, fte->user_page) || pagedir_is_dirty(fte->t->pagedir, fte->kernel_virtual_page_in_user_pool));
-    pagedir_set_dirty(fte->t->pagedir, fte->kernel_virtual_page_in_user_pool, false);
-    
-    //pagedir에서 present bit 갱신
-    pagedir_clear_page(fte->t->pagedir, fte->user_page);
-    free(fte);
+  if(n == 0){
+    /* 모든 frame이 고정되었거나 다른 thread가 evict하는 중이다. */
+    if(frame_events == seen)
+      cond_wait(&eviction_done, &frame_table_lock);
+    lock_release(&frame_table_lock);
+    return;
   }
-  palloc_free_page(kpage);//physical memory에서 이 frame을 없앤다.
-  vm_ft_same_keys_free(removed);
+  lock_release(&frame_table_lock);
+
+  //내용을 swap device에 기록하고 끝나기를 기다린다.
+  vm_swap_out_batch(swap_kpages, sharing_proc_nums, swap_cnt, swap_idx, swap_requests);
+  for(size_t j = 0; j < swap_cnt; ++j)
+    block_wait(&swap_requests[j]);
+
+  lock_acquire(&frame_table_lock);
+
+  for(size_t j = 0; j < n; ++j){
+    struct frame* f = victims[j];
+    bool sharing = list_size(&f->ftes) > 1;
+    struct thread* owner = NULL;
+    struct supplemental_page_table_entry* owner_spte = NULL;
+    while(!list_empty(&f->ftes)){
+      struct frame_table_entry* fte = list_entry(list_front(&f->ftes), struct frame_table_entry, elem);
+
+      //fte의 정보와 일치하는 spte를 찾아서 갱신한다.
+      struct supplemental_page_table_entry* spte = vm_spt_lookup(&fte->t->spt, fte->user_page);
+      if(batch_pos[j] == EVICT_FILE_BACKED)
+        vm_spt_update_after_file_out(spte);
+      else if(batch_pos[j] == EVICT_SWAP_CACHED)
+        vm_spt_update_after_swap_out(spte, spte->swap_slot);
+      else if(batch_pos[j] == EVICT_SAME_FILLED)
+        vm_spt_update_after_fill_out(spte, fill_values[j]);
+      else
+        vm_spt_update_after_swap_out(spte, swap_idx[batch_pos[j]]);
+      owner = fte->t;
+      owner_spte = spte;
+      fte_free(fte);
+    }
+
+    /* 기록이 끝났으므로 swap read-around가 이 slot을 읽어도 된다. */
+    if(batch_pos[j] >= 0 && !sharing)
+      vm_swap_set_owner(swap_idx[batch_pos[j]], owner, owner_spte);
+
+    f->evicting = false;
+    lock_release(&f->lock);
+    palloc_free_page(kpages[j]);//physical memory에서 이 frame을 없앤다.
+  }
+
+  frame_event_locked();
+  lock_release(&frame_table_lock);
+}
+
+
+/* frame이 free되었거나 evict할 수 있게 되었다. eviction_done에서 기다리는 thread들을 깨운다.
+   frame_table_lock을 잡은 채로 호출한다. */
+static void frame_event_locked(void){
+  ASSERT(lock_held_by_current_thread(&frame_table_lock));
+  ++frame_events;
+  cond_broadcast(&eviction_done, &frame_table_lock);
 }
 
 
-/* user pool에서 없으면 swap을 해서라도 frame을 반환하는 palloc_get_page() wrapper함수이다. */
+/* user pool에서 없으면 swap을 해서라도 frame을 반환하는 palloc_get_page() wrapper함수이다.
+   frame_table_lock을 잡지 않은 채로 호출한다.
+   반환한 frame은 아직 frame table에 없으므로 vm_add_fte()를 하기 전까지 evict되지 않는다. */
 static void* vm_super_palloc_get_page(enum palloc_flags flags){
-  void* kernel_virtual_page_in_user_pool = palloc_get_page (PAL_USER | flags);
-  if (kernel_virtual_page_in_user_pool == NULL) { 
-    vm_evict_a_frame_to_swap_device();
-    kernel_virtual_page_in_user_pool = palloc_get_page (PAL_USER | flags);
+  while(true){
+    /* palloc보다 먼저 읽어야 palloc에 실패한 뒤에 free된 frame을 놓치지 않는다. */
+    unsigned seen = frame_events;
+    void* kernel_virtual_page_in_user_pool = palloc_get_page (PAL_USER | flags);
+    if(kernel_virtual_page_in_user_pool != NULL)
+      return kernel_virtual_page_in_user_pool;
+    vm_evict_frames_to_swap_device(seen);
   }
-  return kernel_virtual_page_in_user_pool;
 }
 
 
-/* 새로운 frame table entry를 frame table에 할당하는 함수이다. */
+/* 새로운 frame table entry를 frame table에 할당하는 함수이다. frame_table_lock을 잡은 채로 호출한다. */
 static void vm_add_fte(void* kernel_virtual_page_in_user_pool, void* user_page){
-  struct frame_table_entry* fte = malloc(sizeof(struct frame_table_entry));
+  struct frame_table_entry* fte = fte_alloc();
 
   fte->t = thread_current ();
   fte->user_page = user_page;
@@ -234,103 +661,158 @@ static void vm_add_fte(void* kernel_virtual_page_in_user_pool, void* user_page){
   fte->is_used_for_user_pointer = 0;
   fte->setting_now = true;
 
-  vm_ft_hash_insert (&frame_table, &fte->elem);
+  size_t no = frame_no(kernel_virtual_page_in_user_pool);
+  if(list_empty(&frame_array[no].ftes))
+    policy->insert(no);
+  list_push_back(&frame_array[no].ftes, &fte->elem);
 }
 
 
-/* user page를 위한 새로운 frame을 user pool에서 할당하고 frame table에 기록한다. 
+/* user page를 위한 새로운 frame을 user pool에서 할당하고 frame table에 기록한다.
    새로운 kernel virtual page의 주소(새로운 frame의 주소와 1:1 매핑)를 반환한다.
-   
+
    eviction을 구현한 후 이 함수를 사용하는 곳에서는 synchronize를 구현해야한다.(implement later)
-   
+
    예를들어 일반적으로 f = vm_frame_allocte()를 한 다음 조건에 맞지 않다면 vm_free_allocate(f)를 호출한다.
    p1이 f를 구해서 조건을 확인하는 중이라 하자.
    p2가 f를 eviction한다면..?
-   
+
    예를들어 p1, p2가 이 함수를 동시에 호출한다 하자.
    p1이 palloc으로 빈프레임을 할당받는데 성공하고, p2는 실패한다고 하자.
    p2가 방금 p1이 받은 프레임을 eviction한다면..?
-   
-   즉, palloc으로 받은 프레임으로 사용을 완료할 때 까지는 절대로 eviction되면 안된다. */
-void* vm_frame_allocate (enum palloc_flags flags, void* user_page){
-  sema_down(&frame_table_w);
 
+   즉, palloc으로 받은 프레임으로 사용을 완료할 때 까지는 절대로 eviction되면 안된다.
+   palloc으로 받은 frame은 vm_add_fte() 전까지 frame table에 없고, 이후에는 setting_now이므로 골라지지 않는다. */
+void* vm_frame_allocate (enum palloc_flags flags, void* user_page){
   void* kernel_virtual_page_in_user_pool = vm_super_palloc_get_page(flags);
+
+  lock_acquire(&frame_table_lock);
   vm_add_fte(kernel_virtual_page_in_user_pool, user_page);
+  lock_release(&frame_table_lock);
 
-  sema_up(&frame_table_w);
   return kernel_virtual_page_in_user_pool;
 }
 
-/* ONLY USE IN vm_load_IN_SWAP_to_user_pool(), vm_load_IN_FILE_to_user_pool() */
-static void* vm_frame_allocate_unsafe (enum palloc_flags flags, void* user_page){
-  void* kernel_virtual_page_in_user_pool = vm_super_palloc_get_page(flags);
-  vm_add_fte(kernel_virtual_page_in_user_pool, user_page);
+/* vm_frame_allocate()와 같지만 user pool에 빈 frame이 없다면 evict하지 않고 NULL을 반환한다.
+   swap read-around처럼 없어도 되는 frame을 구할 때 사용한다. */
+void* vm_frame_allocate_if_free (enum palloc_flags flags, void* user_page){
+  void* kernel_virtual_page_in_user_pool = palloc_get_page (PAL_USER | flags);
+  if(kernel_virtual_page_in_user_pool != NULL){
+    lock_acquire(&frame_table_lock);
+    vm_add_fte(kernel_virtual_page_in_user_pool, user_page);
+    lock_release(&frame_table_lock);
+  }
   return kernel_virtual_page_in_user_pool;
 }
 
 
-/* 만약 fte->kernel_virtual_page_in_user_pool이 frame table에서 유일하다면,
-   fte가 나타내는 frame을 deallocate한다.
-   그리고 fte와 정확히 일치하는 데이터를 frame table에서 없앤다. */
-void vm_frame_free (struct frame_table_entry* fte){
-  sema_down(&frame_table_w);
-  
-  /* same as vm_frame_lookup_same_keys() */
-  struct frame_table_entry key;
-  key.kernel_virtual_page_in_user_pool = fte->kernel_virtual_page_in_user_pool;
-  struct vm_ft_same_keys* others = vm_ft_hash_find_same_keys(&frame_table, &(key.elem));
-
-  ASSERT(others != NULL);
-  if(others->len == 1)//no sharing
-    palloc_free_page(fte->kernel_virtual_page_in_user_pool);
-  
-  vm_ft_hash_delete_exactly_identical (&frame_table, &fte->elem);
-  vm_ft_same_keys_free(others);
-  free(fte);
-
-  sema_up(&frame_table_w);
+/* fte를 frame table에서 없애고 fte의 user page를 pagedir에서 지운다.
+   만약 fte가 frame을 사용하는 유일한 fte였다면, frame을 deallocate한다.
+   user pool의 frame은 이 함수에서만 deallocate되므로 frame을 공유하는 프로세스들이 동시에 종료해도
+   한 번만 deallocate된다. frame_table_lock을 잡은 채로 호출한다. */
+static void vm_frame_remove_fte(struct frame_table_entry* fte){
+  void* kernel_virtual_page_in_user_pool = fte->kernel_virtual_page_in_user_pool;
+  struct frame* f = &frame_array[frame_no(kernel_virtual_page_in_user_pool)];
+
+  pagedir_clear_page(fte->t->pagedir, fte->user_page);
+  fte_free(fte);
+  if(list_empty(&f->ftes)){//no sharing
+    frame_unshare(f);
+    palloc_free_page(kernel_virtual_page_in_user_pool);
+    frame_event_locked();
+  }
 }
 
+/* 만약 fte가 frame을 사용하는 유일한 fte라면, fte가 나타내는 frame을 deallocate한다.
+   그리고 fte를 frame table에서 없앤다. */
+void vm_frame_free (struct frame_table_entry* fte){
+  lock_acquire(&frame_table_lock);
+  vm_frame_remove_fte(fte);
+  lock_release(&frame_table_lock);
+}
 
-/* user program이 종료될 때 pagedir_destory()가 호출되면서 실제 physical memory에서 free된다. 
-   이때 frame_table에서는 따로 지워주어야한다.
-   fte의 정보와 정확히 일치하는 데이터를 frame_table에서 없애고 fte를 deallocate한다. */
-void vm_frame_free_only_in_ft(struct frame_table_entry* fte){
-  sema_down(&frame_table_w);
 
-  vm_ft_hash_delete_exactly_identical (&frame_table, &fte->elem);
-  free(fte);
+/* user program이 종료될 때 pagedir_destory()는 user pool의 frame을 free하지 않는다.
+   spte의 정보와 정확히 일치하는 fte를 frame_table에서 없애고, 마지막 fte였다면 frame을 deallocate한다.
+   spte의 user page는 pagedir에서 지워지므로 pagedir_destory()가 이 frame을 다시 보지 않는다.
+   다른 thread가 spte의 page를 evict하는 중이라면 끝나기를 기다린다.
+   기다리는 동안 evict되어 더 이상 frame에 없다면 아무것도 하지 않고 false를 반환한다. */
+bool vm_frame_free_only_in_ft(struct supplemental_page_table_entry* spte){
+  lock_acquire(&frame_table_lock);
+
+  wait_for_eviction_locked(spte);
+  bool in_frame = spte->frame_data_clue == IN_FRAME;
+  if(in_frame){
+    struct frame* f = &frame_array[frame_no(spte->kernel_virtual_page_in_user_pool)];
+    struct frame_table_entry* fte = frame_find_fte(f, thread_current(), spte->user_page);
+    ASSERT(fte != NULL);
+    vm_frame_remove_fte(fte);
+  }
 
-  sema_up(&frame_table_w);
+  lock_release(&frame_table_lock);
+  return in_frame;
 }
 
 
-/* setter */
-static void vm_frame_set_for_user_pointer(struct vm_ft_same_keys* founds, bool value){
-  for(int i = 0; i < founds->len; ++i){
-    struct frame_table_entry* fte = vm_ft_hash_entry(founds->pointers_arr_of_ft_hash_elem[i], struct frame_table_entry, elem);
+/* setter. frame_table_lock을 잡은 채로 호출한다. */
+static void vm_frame_set_for_user_pointer(struct frame* f, bool value){
+  struct list_elem* e;
+  for(e = list_begin(&f->ftes); e != list_end(&f->ftes); e = list_next(e)){
+    struct frame_table_entry* fte = list_entry(e, struct frame_table_entry, elem);
     ASSERT(fte->is_used_for_user_pointer >= 0);
     if(value)
       ++fte->is_used_for_user_pointer;
     else if(!value && fte->is_used_for_user_pointer > 0)
       --fte->is_used_for_user_pointer;
   }
+  if(!value)
+    frame_event_locked();
+}
+
+/* frame을 사용하는 현재 thread의 fte들에 대한 설정이 끝났다. 공유하는 다른 프로세스의 fte는
+   그 프로세스가 설정을 마칠 때까지 그대로 둔다. frame_table_lock을 잡은 채로 호출한다. */
+static void vm_frame_setting_over_locked(struct frame* f){
+  struct thread* t = thread_current();
+  struct list_elem* e;
+  for(e = list_begin(&f->ftes); e != list_end(&f->ftes); e = list_next(e)){
+    struct frame_table_entry* fte = list_entry(e, struct frame_table_entry, elem);
+    if(fte->t == t)
+      fte->setting_now = false;
+  }
+  frame_event_locked();
 }
 
 /* vm_frame_allocate(),
    vm_load_IN_FILE_to_user_pool,
    vm_load_IN_SWAP_to_user_pool 는 새로운 프레임을 할당한다.
-   새로운 프레임에 대한 설정이 완료(= evict해도 된다는 의미)되면 이 함수를 호출한다. */
-void vm_frame_setting_over(struct vm_ft_same_keys* founds){
-  sema_down(&frame_table_w);
+   새로운 프레임에 대한 설정이 완료(= evict해도 된다는 의미)되면 이 함수를 호출한다.
+   frame_array로 바로 찾아가므로 heap 할당이 없다. */
+void vm_frame_setting_over(void* kernel_virtual_page_in_user_pool){
+  lock_acquire(&frame_table_lock);
+  vm_frame_setting_over_locked(&frame_array[frame_no(kernel_virtual_page_in_user_pool)]);
+  lock_release(&frame_table_lock);
+}
 
-  for(int i = 0; i < founds->len; ++i){
-    struct frame_table_entry* fte = vm_ft_hash_entry(founds->pointers_arr_of_ft_hash_elem[i], struct frame_table_entry, elem);
-    fte->setting_now = false;
+
+/* frame에 없는 spte의 page를 page fault handler와 같은 방법으로 새 frame에 올려둔다.
+   새 frame은 setting_now이므로 vm_frame_setting_over() 전까지 evict되지 않는다. */
+static void vm_frame_load_page(struct supplemental_page_table_entry* spte){
+  struct thread* t = thread_current();
+  bool loaded = false;
+
+  if(spte->frame_data_clue == IN_SWAP)
+    loaded = vm_load_IN_SWAP_to_user_pool(spte);
+  else if(spte->frame_data_clue == SAME_FILLED)
+    loaded = vm_load_SAME_FILLED_to_user_pool(spte);
+  else if(spte->frame_data_clue == IN_FILE){
+    loaded = vm_load_IN_FILE_to_user_pool(spte);
+    //kernel_virtual_page_in_user_pool으로 접근해서 설치했으므로 dirty bit가 켜진 상태이다.
+    if(loaded)
+      pagedir_set_dirty (t->pagedir, spte->kernel_virtual_page_in_user_pool, false);
   }
 
-  sema_up(&frame_table_w);
+  if(!loaded)
+    PANIC("user pointer가 가리키는 page를 frame에 올리지 못했다");
 }
 
 
@@ -338,12 +820,13 @@ void vm_frame_setting_over(struct vm_ft_same_keys* founds){
    BLOCK_FILESYS, BLOCK_SWAP 와 같은 block device를 컨트롤하는 block device driver가 있다.
    BLOCK_FILESYS에서 block_read(), block_write()를 호출하는 도중에 page_fault()가 발생하여
    BLOCK_SWAP에서 block_read(), block_write()를 호출하는 상황이 발생하면 안된다.
-   
+
    user_pointer_inclusive 부터 bytes까지 swap device에 존재하는 페이지는 physical memory로 데려온다.
+   데려오는 동안에는 frame_table_lock을 잡지 않는다.
    use in syscall.c */
 void make_user_pointer_in_physical_memory(void* user_pointer_inclusive, size_t bytes){
   struct thread* t = thread_current();
-  
+
   void* new_page = NULL;
   for(size_t i = 0; i < bytes; ++i){
       //페이지가 달라진 경우
@@ -351,62 +834,23 @@ void make_user_pointer_in_physical_memory(void* user_pointer_inclusive, size_t b
         //advanced
         new_page = pg_round_down(user_pointer_inclusive + i);
 
-sema_down(&frame_table_w);
-
         /* 이번 user_pointer_inclusive + i가 속하는 페이지의 spte를 구한다. */
         struct supplemental_page_table_entry* spte = vm_spt_lookup(&t->spt, new_page);
-        bool newly_allocated = false;
-
-
-        if(spte->frame_data_clue == IN_SWAP){
-
-          // same mechanism as  vm_load_IN_SWAP_to_user_pool (spte);
-          void* kernel_virtual_page_in_user_pool = vm_frame_allocate_unsafe(PAL_USER, spte -> user_page);
-          ASSERT(kernel_virtual_page_in_user_pool != NULL);
-          vm_swap_in(spte->swap_slot, kernel_virtual_page_in_user_pool);
-          ASSERT(reinstall_page(spte->user_page, kernel_virtual_page_in_user_pool, spte->writable));
-          // vm_load_IN_SWAP_to_user_pool (spte) over
-
-          newly_allocated = true;
-        }
 
-
-        if(spte->frame_data_clue == IN_FILE){
-
-          // same mechanism as vm_load_IN_FILE_to_user_pool(spte);
-          void* kernel_virtual_page_in_user_pool = vm_frame_allocate_unsafe(PAL_USER, spte -> user_page);
-          ASSERT(kernel_virtual_page_in_user_pool != NULL);
-          file_seek(spte->file, spte->file_offset);
-          int read_bytes = file_read (spte->file, kernel_virtual_page_in_user_pool, spte->read_bytes);
-          ASSERT(read_bytes == spte->read_bytes);
-          ASSERT (spte->read_bytes + spte->zero_bytes == PGSIZE);
-          memset (kernel_virtual_page_in_user_pool + read_bytes, 0, spte->zero_bytes);
-          ASSERT(reinstall_page(spte->user_page, kernel_virtual_page_in_user_pool, spte->writable));
-          // vm_load_IN_FILE_to_user_pool(spte) over
-
-          newly_allocated = true;
+        lock_acquire(&frame_table_lock);
+        wait_for_eviction_locked(spte);
+        if(spte->frame_data_clue != IN_FRAME){
+          lock_release(&frame_table_lock);
+          vm_frame_load_page(spte);
+          lock_acquire(&frame_table_lock);
         }
 
-
         /* 이번 user_pointer_inclusive +i가 나타내는 frame을 구하고 user pointer를 위해 쓰인다고 기록한다. */
-        //same as vm_frame_lookup_same_keys(spte->kernel_virtual_page_in_user_pool); 
-        struct frame_table_entry key;
-        key.kernel_virtual_page_in_user_pool = spte->kernel_virtual_page_in_user_pool;
-        struct vm_ft_same_keys* founds = vm_ft_hash_find_same_keys(&frame_table, &(key.elem));
-
-        vm_frame_set_for_user_pointer(founds, true);
-        vm_ft_same_keys_free(founds);
-
-        // same as vm_frame_setting_over(vm_frame_lookup_same_keys(spte->kernel_virtual_page_in_user_pool));
-        key.kernel_virtual_page_in_user_pool = spte->kernel_virtual_page_in_user_pool;
-        founds = vm_ft_hash_find_same_keys(&frame_table, &(key.elem));
-        for(int i = 0; i < founds->len; ++i){
-          struct frame_table_entry* fte = vm_ft_hash_entry(founds->pointers_arr_of_ft_hash_elem[i], struct frame_table_entry, elem);
-          fte->setting_now = false;
-        }
-        vm_ft_same_keys_free(founds);
+        struct frame* f = &frame_array[frame_no(spte->kernel_virtual_page_in_user_pool)];
+        vm_frame_set_for_user_pointer(f, true);
+        vm_frame_setting_over_locked(f);
 
-sema_up(&frame_table_w);
+        lock_release(&frame_table_lock);
       }
   }
 }
@@ -423,10 +867,10 @@ void unmake(void* user_pointer_inclusive, size_t bytes){
         //이번 user_pointer_inclusive + i가 속하는 페이지의 spte를 구한다.
         struct supplemental_page_table_entry* spte = vm_spt_lookup(&t->spt, new_page);
 
-        //이번 user_pointer_inclusive +i가 나타내는 frame을 구하고 user pointer를 위해 쓰인다고 기록한다.
-        struct vm_ft_same_keys* founds = vm_frame_lookup_same_keys(spte->kernel_virtual_page_in_user_pool); 
-        vm_frame_set_for_user_pointer(founds, false);
-        vm_ft_same_keys_free(founds);
+        //이번 user_pointer_inclusive +i가 나타내는 frame을 구하고 user pointer를 위해 쓰이지 않는다고 기록한다.
+        lock_acquire(&frame_table_lock);
+        vm_frame_set_for_user_pointer(&frame_array[frame_no(spte->kernel_virtual_page_in_user_pool)], false);
+        lock_release(&frame_table_lock);
       }
   }
 }
@@ -435,21 +879,71 @@ void unmake(void* user_pointer_inclusive, size_t bytes){
 
 
 
-/* hash function들 */
-static unsigned frame_table_hash_func(const struct vm_ft_hash_elem *e, void* aux UNUSED)
-{
-  struct frame_table_entry* fte = vm_ft_hash_entry(e, struct frame_table_entry, elem);
-  return vm_ft_hash_int((int)fte->kernel_virtual_page_in_user_pool);
+/* user pool에서 kernel_virtual_page_in_user_pool이 나타내는 frame의 번호. frame_array의 index이다. */
+static size_t frame_no(void* kernel_virtual_page_in_user_pool){
+  size_t no = ((uint8_t*)kernel_virtual_page_in_user_pool - user_pool_base) / PGSIZE;
+  ASSERT(pg_ofs(kernel_virtual_page_in_user_pool) == 0 && no < user_pool_frames);
+  return no;
+}
+
+
+/* shared_frames의 hash 함수들 */
+static unsigned shared_frame_hash_func(const struct hash_elem* elem, void* aux UNUSED){
+  struct frame* f = hash_entry(elem, struct frame, shared_elem);
+  return hash_int((int)f->shared_inode) ^ hash_int(f->shared_offset) ^ hash_int(f->shared_read_bytes);
 }
-static bool frame_table_less_func(const struct vm_ft_hash_elem *a, const struct vm_ft_hash_elem *b, void *aux UNUSED)
-{
-  struct frame_table_entry *fte_a = vm_ft_hash_entry(a, struct frame_table_entry, elem);
-  struct frame_table_entry *fte_b = vm_ft_hash_entry(b, struct frame_table_entry, elem);
-  return fte_a->kernel_virtual_page_in_user_pool < fte_b->kernel_virtual_page_in_user_pool;
+static bool shared_frame_less_func(const struct hash_elem* a, const struct hash_elem* b, void* aux UNUSED){
+  struct frame* f_a = hash_entry(a, struct frame, shared_elem);
+  struct frame* f_b = hash_entry(b, struct frame, shared_elem);
+  if(f_a->shared_inode != f_b->shared_inode)
+    return f_a->shared_inode < f_b->shared_inode;
+  if(f_a->shared_offset != f_b->shared_offset)
+    return f_a->shared_offset < f_b->shared_offset;
+  return f_a->shared_read_bytes < f_b->shared_read_bytes;
+}
+
+
+/* 교체 정책 함수들 */
+static void frame_policy_nop(void){
+}
+static void frame_policy_insert_nop(size_t no UNUSED){
+}
+
+static void wsclock_aging_thread(void* aux);
+
+static void wsclock_init(void){
+  frame_ages = calloc(user_pool_frames, sizeof *frame_ages);
+  frame_last_use = calloc(user_pool_frames, sizeof *frame_last_use);
+  if(frame_ages == NULL || frame_last_use == NULL)
+    PANIC("wsclock age table creation failed");
+}
+
+static void wsclock_start(void){
+  thread_create("frame_aging", PRI_DEFAULT, wsclock_aging_thread, NULL);
+}
+
+/* 새로 사용되기 시작한 frame은 방금 접근된 것으로 본다. */
+static void wsclock_insert(size_t no){
+  frame_ages[no] = 0x80;
+  frame_last_use[no] = timer_ticks();
+}
+
+/* WSCLOCK_AGING_INTERVAL tick마다 access bit를 frame_ages, frame_last_use로 모은다. */
+static void wsclock_aging_thread(void* aux UNUSED){
+  for(;;){
+    timer_sleep(WSCLOCK_AGING_INTERVAL);
+
+    lock_acquire(&frame_table_lock);
+    int64_t now = timer_ticks();
+    for(size_t i = 0; i < user_pool_frames; ++i){
+      if(list_empty(&frame_array[i].ftes) || frame_array[i].evicting)
+        continue;
+      frame_ages[i] >>= 1;
+      if(test_and_clear_accessed(&frame_array[i])){
+        frame_ages[i] |= 0x80;
+        frame_last_use[i] = now;
+      }
+    }
+    lock_release(&frame_table_lock);
+  }
 }
-static bool frame_table_value_less_func(const struct vm_ft_hash_elem*a, const struct vm_ft_hash_elem*b, void *aux)
-{
-  struct frame_table_entry *fte_a = vm_ft_hash_entry(a, struct frame_table_entry, elem);
-  struct frame_table_entry *fte_b = vm_ft_hash_entry(b, struct frame_table_entry, elem);
-  return fte_a->user_page < fte_b->user_page;
-}
\ No newline at end of file
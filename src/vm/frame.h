@@ -3,22 +3,28 @@
 
 #include "threads/synch.h"
 #include "threads/palloc.h"
-#include "vm/frame-table-hash.h"
 #include "vm/page.h"
 
 void vm_frame_init (void);
+void vm_frame_start (void);
+bool vm_frame_set_policy (const char* name);
 void* vm_frame_allocate (enum palloc_flags, void *);
+void* vm_frame_allocate_if_free (enum palloc_flags, void *);
 
 void make_user_pointer_in_physical_memory(void* user_pointer_inclusive, size_t bytes);
 void unmake(void* user_pointer_inclusive, size_t bytes);
 
 struct frame_table_entry;
 void vm_frame_free (struct frame_table_entry* fte);
-void vm_frame_free_only_in_ft(struct frame_table_entry* fte);
+bool vm_frame_free_only_in_ft(struct supplemental_page_table_entry* spte);
+void vm_frame_wait_for_eviction(struct supplemental_page_table_entry* spte);
 
 struct frame_table_entry* vm_frame_lookup_exactly_identical(struct supplemental_page_table_entry* spte);
-struct vm_ft_same_keys* vm_frame_lookup_same_keys(void* kernel_virtual_page_in_user_pool);
+bool vm_frame_in_user_pool(void* kernel_virtual_page);
 
-void vm_frame_setting_over(struct vm_ft_same_keys* founds);
+void* vm_frame_share_lookup(struct supplemental_page_table_entry* spte);
+void vm_frame_share_register(struct supplemental_page_table_entry* spte);
+
+void vm_frame_setting_over(void* kernel_virtual_page_in_user_pool);
 
 #endif /* vm/frame.h */
\ No newline at end of file
@@ -40,9 +40,57 @@ void vm_spt_update_after_swap_out(struct supplemental_page_table_entry* spte, si
   spte->frame_data_clue = IN_SWAP;
   spte->kernel_virtual_page_in_user_pool = NULL;
   spte->swap_slot = swap_slot;
+  spte->swap_cached = false;
 }
 
 
+/* swap device에서 읽어들인 page의 swap slot을 놓지 않고 기억해둔다(swap cache).
+   설치한 직후에 불러야한다. 읽어들이면서 kernel address로 기록했으므로 양쪽 alias의 dirty bit를 끈다.
+   이후 evict할 때 둘 다 여전히 꺼져있다면 swap_slot에 다시 기록할 필요가 없다. */
+static void vm_spt_keep_swap_cache(struct supplemental_page_table_entry* spte){
+  struct thread* t = thread_current();
+
+  ASSERT(spte->frame_data_clue == IN_FRAME);
+  spte->swap_cached = true;
+  pagedir_set_dirty(t->pagedir, spte->user_page, false);
+  pagedir_set_dirty(t->pagedir, spte->kernel_virtual_page_in_user_pool, false);
+}
+
+
+/* page가 수정되었거나 더 이상 필요없으므로 swap cache가 잡고 있던 slot을 놓는다. */
+void vm_spt_drop_swap_cache(struct supplemental_page_table_entry* spte){
+  if(spte->swap_cached){
+    vm_swap_free(spte->swap_slot);
+    spte->swap_cached = false;
+  }
+}
+
+
+/* evict할 때 모든 word가 같은 값이었던 page는 swap slot 없이 그 값만 기억한다.
+   (새로 자란 stack, PAL_ZERO로 할당된 page, bss 등) */
+void vm_spt_update_after_fill_out(struct supplemental_page_table_entry* spte, uint32_t fill_value){
+  spte->frame_data_clue = SAME_FILLED;
+  spte->kernel_virtual_page_in_user_pool = NULL;
+  spte->fill_value = fill_value;
+  spte->swap_cached = false;
+}
+
+
+/* evict할 때 실행 파일의 읽기 전용 page는 기록하지 않고, 다시 실행 파일에서 읽어오도록 IN_FILE로 되돌린다.
+   file, file_offset, read_bytes, zero_bytes는 처음 등록할 때의 값이 그대로 남아있다. */
+void vm_spt_update_after_file_out(struct supplemental_page_table_entry* spte){
+  spte->frame_data_clue = IN_FILE;
+  spte->kernel_virtual_page_in_user_pool = NULL;
+  spte->swap_cached = false;
+}
+
+
+/* swap read-around에서 함께 살펴볼, 정렬된 swap slot 구간의 크기.
+   eviction은 이웃한 page들을 인접한 slot에 기록하므로 곧 이웃한 page들도 fault가 날 가능성이 높다. */
+#define SWAP_READ_AROUND 8
+
+static void vm_swap_read_around(struct supplemental_page_table_entry* spte);
+
 /* swap device의 데이터를 frame table에 올려둔다(swap.c:vm_swap_in() 사용).
    성공 여부를 반환한다. proj4 pptx)Page Fault Handler 참조 */
 bool vm_load_IN_SWAP_to_user_pool(struct supplemental_page_table_entry* spte){
@@ -55,11 +103,16 @@ bool vm_load_IN_SWAP_to_user_pool(struct supplemental_page_table_entry* spte){
   }
 
   //Swap page into frame from disk
-  vm_swap_in(spte->swap_slot, kernel_virtual_page_in_user_pool);
+  size_t swap_slot = spte->swap_slot;
+  struct block_request request;
+  vm_swap_in_async(swap_slot, kernel_virtual_page_in_user_pool, &request);
+  vm_swap_read_around(spte);
+  block_wait(&request);
 
   //Modify page and swap manage tables
   if(!reinstall_page(spte->user_page, kernel_virtual_page_in_user_pool, spte->writable)) {
     PANIC("install_page 에러");
+    vm_swap_release(swap_slot);
     struct supplemental_page_table_entry key;
     key.kernel_virtual_page_in_user_pool = kernel_virtual_page_in_user_pool;
     key.user_page = spte->user_page;
@@ -67,13 +120,112 @@ bool vm_load_IN_SWAP_to_user_pool(struct supplemental_page_table_entry* spte){
     vm_frame_free(fte);
     return false;
   }
+  vm_spt_keep_swap_cache(spte);
   
   return true;
 }
 
 
+/* spte의 swap slot과 같은 구간에 있는 현재 프로세스의 다른 page들을 빈 frame이 있는 만큼 함께 읽어서 설치한다.
+   spte의 읽기가 이미 시작된 뒤에 호출하므로 인접한 읽기들은 block queue에서 하나로 합쳐진다.
+   빈 frame이 없다면 evict하지 않고 그만둔다. */
+static void vm_swap_read_around(struct supplemental_page_table_entry* spte){
+  struct supplemental_page_table_entry* neighbours[SWAP_READ_AROUND];
+  void* kpages[SWAP_READ_AROUND];
+  struct block_request requests[SWAP_READ_AROUND];
+
+  size_t n = vm_swap_owned_neighbours(spte->swap_slot, SWAP_READ_AROUND, neighbours);
+  size_t read_cnt = 0;
+  for(size_t i = 0; i < n; ++i){
+    /* swap cache로 slot을 잡고 있는 page는 이미 frame에 있다. */
+    struct supplemental_page_table_entry* e = neighbours[i];
+    if(e->frame_data_clue != IN_SWAP)
+      continue;
+    kpages[read_cnt] = vm_frame_allocate_if_free(PAL_USER, e->user_page);
+    if(kpages[read_cnt] == NULL)
+      break;
+    vm_swap_in_async(e->swap_slot, kpages[read_cnt], &requests[read_cnt]);
+    neighbours[read_cnt++] = e;
+  }
+
+  for(size_t i = 0; i < read_cnt; ++i){
+    struct supplemental_page_table_entry* e = neighbours[i];
+    block_wait(&requests[i]);
+    if(!reinstall_page(e->user_page, kpages[i], e->writable))
+      PANIC("install_page 에러");
+    vm_spt_keep_swap_cache(e);
+
+    vm_frame_setting_over(kpages[i]);
+  }
+}
+
+
+/* SAME_FILLED인 page를 새 frame에 다시 채워서 올려둔다. swap device는 건드리지 않는다.
+   성공 여부를 반환한다. */
+bool vm_load_SAME_FILLED_to_user_pool(struct supplemental_page_table_entry* spte){
+  ASSERT(spte->frame_data_clue == SAME_FILLED);
+  void* kernel_virtual_page_in_user_pool = vm_frame_allocate(PAL_USER, spte -> user_page);//Page replacement algorithm
+  if(kernel_virtual_page_in_user_pool == NULL){
+    PANIC("frame allocate 에러");
+    return false;
+  }
+
+  vm_page_fill(kernel_virtual_page_in_user_pool, spte->fill_value);
+
+  if(!reinstall_page(spte->user_page, kernel_virtual_page_in_user_pool, spte->writable)) {
+    PANIC("install_page 에러");
+    struct supplemental_page_table_entry key;
+    key.kernel_virtual_page_in_user_pool = kernel_virtual_page_in_user_pool;
+    key.user_page = spte->user_page;
+    struct frame_table_entry* fte = vm_frame_lookup_exactly_identical(&key);
+    vm_frame_free(fte);
+    return false;
+  }
+
+  return true;
+}
+
+
+/* kernel_virtual_page의 모든 word가 같은 값이라면 그 값을 fill_value에 저장하고 true를 반환한다. */
+bool vm_page_is_same_filled(const void* kernel_virtual_page, uint32_t* fill_value){
+  const uint32_t* words = kernel_virtual_page;
+  for(size_t i = 1; i < PGSIZE / sizeof *words; ++i)
+    if(words[i] != words[0])
+      return false;
+  *fill_value = words[0];
+  return true;
+}
+
+
+/* kernel_virtual_page의 모든 word를 fill_value로 채운다. */
+void vm_page_fill(void* kernel_virtual_page, uint32_t fill_value){
+  uint32_t* words = kernel_virtual_page;
+  for(size_t i = 0; i < PGSIZE / sizeof *words; ++i)
+    words[i] = fill_value;
+}
+
+
 bool vm_load_IN_FILE_to_user_pool(struct supplemental_page_table_entry* spte){
   ASSERT(spte->frame_data_clue == IN_FILE);
+
+  /* 실행 파일의 읽기 전용 page는 같은 실행 파일을 실행하는 다른 프로세스가 이미 읽어둔 frame을 함께 사용한다.
+     (text segment) 수정될 수 없으므로 프로세스마다 따로 읽어올 필요가 없다. */
+  if(!spte->writable){
+    void* shared_page = vm_frame_share_lookup(spte);
+    if(shared_page != NULL){
+      if(!reinstall_page(spte->user_page, shared_page, spte->writable)) {
+        PANIC("install_page 에러");
+        struct supplemental_page_table_entry key;
+        key.kernel_virtual_page_in_user_pool = shared_page;
+        key.user_page = spte->user_page;
+        struct frame_table_entry* fte = vm_frame_lookup_exactly_identical(&key);
+        vm_frame_free(fte);
+        return false;
+      }
+      return true;
+    }
+  }
+
   //Is there remaining?
   void* kernel_virtual_page_in_user_pool = vm_frame_allocate(PAL_USER, spte -> user_page);//Page replacement algorithm
   if(kernel_virtual_page_in_user_pool == NULL){
@@ -107,6 +259,9 @@ bool vm_load_IN_FILE_to_user_pool(struct supplemental_page_table_entry* spte){
     return false;
   }
 
+  if(!spte->writable)
+    vm_frame_share_register(spte);
+
   return true;
 }
 
@@ -117,14 +272,15 @@ bool vm_load_IN_FILE_to_user_pool(struct supplemental_page_table_entry* spte){
 bool vm_save_IN_FRAME_to_file(struct thread* t, struct supplemental_page_table_entry* spte){
   ASSERT(spte->frame_data_clue == IN_FRAME);
   ASSERT(spte->file != NULL);
-  bool dirty = pagedir_is_dirty(t->pagedir, spte->user_page) || pagedir_is_dirty(t->pagedir, spte->kernel_virtual_page_in_user_pool);
+  bool dirty = spte->file_dirty
+               || pagedir_is_dirty(t->pagedir, spte->user_page) || pagedir_is_dirty(t->pagedir, spte->kernel_virtual_page_in_user_pool);
 
   if(dirty){
     file_write_at(spte->file, spte->user_page, spte->read_bytes,spte->file_offset);
   }
   struct frame_table_entry* fte = vm_frame_lookup_exactly_identical(spte);
-  vm_frame_free(fte);
-  pagedir_clear_page(t->pagedir, spte->user_page);
+  vm_frame_free(fte);//pagedir에서도 지운다.
+  vm_spt_drop_swap_cache(spte);
   hash_delete(&t->spt, &spte->elem);
   free(spte);
 }
@@ -157,6 +313,9 @@ void vm_spt_install_IN_FRAME_page(struct hash* spt, void* user_page, void* kerne
   spte->frame_data_clue = IN_FRAME;
   spte->kernel_virtual_page_in_user_pool = kernel_virtual_page_in_user_pool;
   spte->writable = writable;
+  spte->swap_cached = false;
+  spte->file_dirty = false;
+  spte->file = NULL;
 
   hash_insert (spt, &spte->elem);
   return;
@@ -174,6 +333,8 @@ void vm_spt_install_IN_FILE_page (struct hash *spt, void *user_page,
   spte->kernel_virtual_page_in_user_pool = NULL;
   spte->frame_data_clue = IN_FILE;
   spte->writable = writable;
+  spte->swap_cached = false;
+  spte->file_dirty = false;
   spte->file = file;
   spte->file_offset = offset;
   spte->read_bytes = read_bytes;
@@ -198,9 +359,10 @@ static void spte_destroy_func(struct hash_elem *elem, void *aux UNUSED){
 
   /* user program이 종료될 때 pagedir_destory()가 호출되면서 실제 physical memory에서 free된다. 
      이때 frame_table에서 지워주어야한다. */
-  if (entry->frame_data_clue == IN_FRAME) {
-    vm_frame_free_only_in_ft(vm_frame_lookup_exactly_identical(entry));
+  if (entry->frame_data_clue == IN_FRAME && vm_frame_free_only_in_ft(entry)) {
+    vm_spt_drop_swap_cache(entry);
   }
+  /* 다른 thread가 evict하는 중이었다면 vm_frame_free_only_in_ft()가 끝나기를 기다렸으므로 IN_SWAP일 수 있다. */
   else if(entry->frame_data_clue == IN_SWAP) {
     vm_swap_free (entry->swap_slot);
   }
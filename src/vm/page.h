@@ -9,6 +9,7 @@
 enum clue_of_frame_data{
     IN_SWAP,        /* swap disk에 존재한다. */
     IN_FRAME,       /* 현재 physical memory에 존재한다. */
+    SAME_FILLED,    /* 모든 word가 fill_value인 page. swap device 없이 다시 채운다. */
     //ZEROING,        /* mmap에서 이용 */
     IN_FILE         /* mmap에서 이용(lazy load) */
 };
@@ -40,6 +41,12 @@ struct supplemental_page_table_entry{
     bool writable;                                   /* same as pte R/W bit */
 
     size_t swap_slot;                                /* frame이 swap_device에 존재하는 경우 어느 슬롯에 잇는가 */
+    bool swap_cached;                                /* IN_FRAME이지만 swap_slot에 아직 같은 내용이 남아있는가.
+                                                        page가 clean하다면 다시 evict할 때 기록하지 않는다. */
+    bool file_dirty;                                 /* file을 읽어온 뒤 수정된 채로 evict된 적이 있다.
+                                                        swap에서 다시 읽어오면서 dirty bit가 꺼져도
+                                                        mmap page라면 file에 기록해야한다. */
+    uint32_t fill_value;                             /* SAME_FILLED인 경우 page를 채우고 있던 값 */
 
     // mmap
     struct file* file;
@@ -52,9 +59,16 @@ void vm_spt_destroy (struct hash* spt);
 struct supplemental_page_table_entry* vm_spt_lookup(struct hash*, void*);
 
 void vm_spt_update_after_swap_out(struct supplemental_page_table_entry* spte, size_t swap_slot);
+void vm_spt_update_after_fill_out(struct supplemental_page_table_entry* spte, uint32_t fill_value);
+void vm_spt_update_after_file_out(struct supplemental_page_table_entry* spte);
+void vm_spt_drop_swap_cache(struct supplemental_page_table_entry* spte);
 bool vm_load_IN_SWAP_to_user_pool(struct supplemental_page_table_entry* spte);
+bool vm_load_SAME_FILLED_to_user_pool(struct supplemental_page_table_entry* spte);
 bool vm_load_IN_FILE_to_user_pool(struct supplemental_page_table_entry* spte);
 
+bool vm_page_is_same_filled(const void* kernel_virtual_page, uint32_t* fill_value);
+void vm_page_fill(void* kernel_virtual_page, uint32_t fill_value);
+
 bool vm_save_IN_FRAME_to_file(struct thread* t, struct supplemental_page_table_entry* spte);
 
 void vm_spt_set_IN_FRAME_page(struct hash* spt, void* user_page, void* kernel_virtual_page_in_user_pool
@@ -1,4 +1,8 @@
 #include <bitmap.h>
+#include <list.h>
+#include <round.h>
+#include <string.h>
+#include "threads/malloc.h"
 #include "threads/vaddr.h"
 #include "devices/block.h"
 #include "vm/swap.h"
@@ -6,6 +10,7 @@
 #include "filesys/off_t.h"
 #include "threads/palloc.h"
 #include "vm/page.h"
+#include "vm/zswap.h"
 
 /* block_read(), block_write() wrapper and bitmap manipulation functions are defined in swap.c */
 
@@ -19,11 +24,47 @@ struct block* swap_device;
 
 /* swap table bitmap 대신 배열을 사용한다. 값은 현재 이 swap slot을 사용하는 프로세스의 개수를 나타낸다. */
 static uint8_t* swap_table;
-static int swap_table_len;
+static size_t swap_table_len;
+
+/* swap slot은 SWAP_CLUSTER_SLOTS개씩 묶은 cluster 단위로 나누어준다.
+   비어있는 cluster 하나를 current로 정해두고 앞에서부터 차례로 나누어주므로,
+   연달아 evict된 page들은 disk에서 인접한 slot에 기록되어 하나의 큰 요청으로 합쳐질 수 있다.
+   current가 다 차면 빈 cluster를, 없다면 일부만 빈 cluster를 새 current로 정한다.
+   목록에서 꺼내고 cluster 안에서 SWAP_CLUSTER_SLOTS개 이하를 살펴보므로 할당과 해제는 O(1)이다. */
+#define SWAP_CLUSTER_SLOTS 16
+
+struct swap_cluster{
+  struct list_elem elem;    /* free_clusters 또는 partial_clusters의 원소. current이거나 가득 찼다면 어디에도 없다. */
+  size_t free_cnt;          /* 비어있는 slot의 개수 */
+};
+
+/* swap slot에 기록된 page의 주인. swap read-around가 인접한 slot의 page를 찾을 때 사용한다.
+   한 프로세스만 사용하는 slot에 대해서만 기록이 끝난 뒤 설정되고, slot이 해제될 때 지워진다.
+   spte는 주인 thread만 해제하므로 t가 현재 thread라면 spte는 유효하다. */
+struct swap_owner{
+  struct thread* t;
+  struct supplemental_page_table_entry* spte;
+};
+static struct swap_owner* swap_owners;
+
+static struct swap_cluster* clusters;
+static size_t cluster_cnt;
+static struct list free_clusters;     /* 모든 slot이 비어있는 cluster들 */
+static struct list partial_clusters;  /* 일부 slot만 비어있는 cluster들 */
+static struct swap_cluster* current;  /* slot을 나누어주고 있는 cluster, 또는 null */
+static size_t current_next;           /* current에서 다음으로 살펴볼 slot */
 
 /* bitmap 조작만은 무조건 lock이 걸려져야 한다. */
 static struct lock swap_table_mutex;
 
+static size_t swap_slot_alloc(int sharing_proc_num);
+static void swap_reserve_run(size_t n);
+static void swap_retire_current(void);
+static void swap_write_async(size_t swap_slot, void* kernel_virtual_page_in_user_pool, struct block_request* request);
+static void swap_slot_release(size_t swap_slot);
+static size_t cluster_first_slot(const struct swap_cluster* c);
+static size_t cluster_slot_cnt(const struct swap_cluster* c);
+
 /* Initializes the swap system module. */
 void vm_swapsys_init(){
   swap_device = block_get_role (BLOCK_SWAP);
@@ -33,64 +74,262 @@ void vm_swapsys_init(){
   /* free map init */
   swap_table_len = (block_size (swap_device) / NUM_OF_SECTORS_ON_A_FRAME);
   swap_table = (uint8_t*)malloc(sizeof(uint8_t) * swap_table_len);
+  cluster_cnt = DIV_ROUND_UP(swap_table_len, SWAP_CLUSTER_SLOTS);
+  clusters = malloc(sizeof *clusters * cluster_cnt);
+  swap_owners = malloc(sizeof *swap_owners * swap_table_len);
+  if (swap_table == NULL || clusters == NULL || swap_owners == NULL)
+    PANIC ("swap_table creation failed--swap system device is too large");
   memset(swap_table, 0, sizeof(uint8_t) * swap_table_len);
+  memset(swap_owners, 0, sizeof *swap_owners * swap_table_len);
 
-  if (swap_table == NULL)
-    PANIC ("swap_table creation failed--swap system device is too large");
+  list_init(&free_clusters);
+  list_init(&partial_clusters);
+  for(size_t i = 0; i < cluster_cnt; ++i){
+    clusters[i].free_cnt = cluster_slot_cnt(&clusters[i]);
+    list_push_back(&free_clusters, &clusters[i].elem);
+  }
+  current = NULL;
   lock_init(&swap_table_mutex);
+  vm_zswap_init(swap_table_len);
 }
 
 /* swap_device에서 swap_slot에 저장된 데이터를 kernel_virtual_page_in_user_pool에 복사한다.
    read(swap_slot, kernel_virtual_page_in_user_pool, sizeof(PGSIZE)) 느낌 */
 void vm_swap_in(size_t swap_slot, void* kernel_virtual_page_in_user_pool){
-  block_sector_t start = (block_sector_t)swap_slot * NUM_OF_SECTORS_ON_A_FRAME;
-  /* start부터 한 프레임 분량의 섹터(NUM_OF_SECTORS_ON_A_FRAME)를 읽어서 
-     kernel_virtual_page_in_user_pool에다 기록한다.  */
-  off_t bytes_read;
-  block_sector_t sector_idx;
-
-  for(bytes_read = 0, sector_idx = start; sector_idx < start + NUM_OF_SECTORS_ON_A_FRAME;
-        ++sector_idx, bytes_read += BLOCK_SECTOR_SIZE){
-    /* Read full one sector directly into kernel_virtual_page_in_user_pool. */
-    block_read (swap_device, sector_idx, kernel_virtual_page_in_user_pool + bytes_read);
+  struct block_request request;
+  vm_swap_in_async(swap_slot, kernel_virtual_page_in_user_pool, &request);
+  block_wait(&request);
+  vm_swap_release(swap_slot);
+}
+
+/* swap_slot을 kernel_virtual_page_in_user_pool로 읽기 시작한다.
+   block_wait(request)가 반환된 뒤 vm_swap_release(swap_slot)을 호출해야한다.
+   그 전에 slot을 놓으면 다른 page가 같은 slot에 기록될 수 있다. */
+void vm_swap_in_async(size_t swap_slot, void* kernel_virtual_page_in_user_pool, struct block_request* request){
+  /* zswap이 보관하고 있었다면 disk를 읽을 필요가 없다. */
+  if(vm_zswap_load(swap_slot, kernel_virtual_page_in_user_pool)){
+    block_request_init_done(request);
+    return;
   }
+
+  block_sector_t start = (block_sector_t)swap_slot * NUM_OF_SECTORS_ON_A_FRAME;
+  /* start부터 한 프레임 분량의 섹터(NUM_OF_SECTORS_ON_A_FRAME)를 한 번의 요청으로 읽어서
+     kernel_virtual_page_in_user_pool에다 기록한다. */
+  block_submit (swap_device, request, false, start, NUM_OF_SECTORS_ON_A_FRAME, kernel_virtual_page_in_user_pool, NULL, NULL);
+}
+
+/* 읽어들인 swap_slot을 놓는다. */
+void vm_swap_release(size_t swap_slot){
   lock_acquire(&swap_table_mutex);
   /* kernel space에 존재하므로 free_map->bits[swap_slot] available for use. */
-  swap_table[swap_slot] = 0;
+  if(swap_table[swap_slot] != 0){
+    swap_table[swap_slot] = 0;
+    swap_slot_release(swap_slot);
+  }
   lock_release(&swap_table_mutex);
 }
 
+
+/* swap_slot에 기록된 page가 thread t의 spte임을 기록한다. 기록이 끝난 뒤에 호출해야한다. */
+void vm_swap_set_owner(size_t swap_slot, struct thread* t, struct supplemental_page_table_entry* spte){
+  lock_acquire(&swap_table_mutex);
+  ASSERT(swap_table[swap_slot] == 1);
+  swap_owners[swap_slot].t = t;
+  swap_owners[swap_slot].spte = spte;
+  lock_release(&swap_table_mutex);
+}
+
+
+/* swap_slot이 속한, window개의 slot으로 정렬된 구간에서 현재 thread가 주인인 다른 slot들의 spte를
+   최대 window - 1개까지 sptes[]에 담고 그 개수를 반환한다. */
+size_t vm_swap_owned_neighbours(size_t swap_slot, size_t window, struct supplemental_page_table_entry** sptes){
+  struct thread* cur = thread_current();
+  size_t first = swap_slot - swap_slot % window;
+  size_t cnt = 0;
+
+  lock_acquire(&swap_table_mutex);
+  for(size_t i = first; i < first + window && i < swap_table_len; ++i)
+    if(i != swap_slot && swap_table[i] != 0 && swap_owners[i].t == cur)
+      sptes[cnt++] = swap_owners[i].spte;
+  lock_release(&swap_table_mutex);
+  return cnt;
+}
+
+
 /* kernel_virtual_page_in_user_pool를 swap_device에 기록한다.
    페이지를 기록한 swap slot의 번호를 반환한다.
    write(swap_slot, kernel_virtual_page_in_user_pool, sizeof(PGSIZE)) 느낌 */
 size_t vm_swap_out(void* kernel_virtual_page_in_user_pool, int sharing_proc_num){
+  struct block_request request;
+  size_t swap_slot = vm_swap_out_async(kernel_virtual_page_in_user_pool, sharing_proc_num, &request);
+  block_wait(&request);
+  return swap_slot;
+}
+
+/* vm_swap_out()과 같지만 기록이 끝나기를 기다리지 않는다.
+   block_wait(request)가 반환될 때까지 kernel_virtual_page_in_user_pool을 재사용하면 안된다. */
+size_t vm_swap_out_async(void* kernel_virtual_page_in_user_pool, int sharing_proc_num, struct block_request* request){
   lock_acquire(&swap_table_mutex);
-  size_t swap_slot;
-  for(swap_slot = 0; swap_slot < swap_table_len; ++swap_slot)
-    if(swap_table[swap_slot] == 0){
-      swap_table[swap_slot] = sharing_proc_num;
-      break;
-    }
+  size_t swap_slot = swap_slot_alloc(sharing_proc_num);
   lock_release(&swap_table_mutex);
 
-  block_sector_t start = (block_sector_t)swap_slot * NUM_OF_SECTORS_ON_A_FRAME;
-  off_t bytes_read;
-  block_sector_t sector_idx;
-  
-  for(bytes_read = 0, sector_idx = start; sector_idx < start + NUM_OF_SECTORS_ON_A_FRAME;
-        ++sector_idx, bytes_read += BLOCK_SECTOR_SIZE){
-    /* Write full one sector directly into kernel_virtual_page_in_user_pool. */
-    block_write (swap_device, sector_idx, kernel_virtual_page_in_user_pool + bytes_read);
-  }
+  swap_write_async(swap_slot, kernel_virtual_page_in_user_pool, request);
   return swap_slot;
 }
 
+/* n개의 page kpages[]를 swap device의 인접한 slot들에 기록하기 시작한다.
+   kpages[i]를 기록한 slot은 slots[i]에 저장하고, 기록은 requests[i]로 추적한다.
+   같은 cluster의 인접한 slot을 받으므로 block queue에서 하나의 큰 순차 기록으로 합쳐진다.
+   각 block_wait(&requests[i])가 반환될 때까지 kpages[i]를 재사용하면 안된다. */
+void vm_swap_out_batch(void** kpages, const int* sharing_proc_nums, size_t n,
+                       size_t* slots, struct block_request* requests){
+  ASSERT(n <= SWAP_CLUSTER_SLOTS);
+  if(n == 0)
+    return;
+
+  lock_acquire(&swap_table_mutex);
+  swap_reserve_run(n);
+  for(size_t i = 0; i < n; ++i)
+    slots[i] = swap_slot_alloc(sharing_proc_nums[i]);
+  lock_release(&swap_table_mutex);
+
+  for(size_t i = 0; i < n; ++i)
+    swap_write_async(slots[i], kpages[i], &requests[i]);
+}
+
+
+/* kernel_virtual_page_in_user_pool을 swap_slot의 내용으로 기록하기 시작한다.
+   zswap에 압축해서 보관할 수 있다면 disk에 기록하지 않고 request를 바로 완료시킨다. */
+static void swap_write_async(size_t swap_slot, void* kernel_virtual_page_in_user_pool, struct block_request* request){
+  if(vm_zswap_store(swap_slot, kernel_virtual_page_in_user_pool)){
+    block_request_init_done(request);
+    return;
+  }
+
+  block_sector_t start = (block_sector_t)swap_slot * NUM_OF_SECTORS_ON_A_FRAME;
+  /* 한 프레임 분량의 섹터를 한 번의 요청으로 기록한다. */
+  block_submit (swap_device, request, true, start, NUM_OF_SECTORS_ON_A_FRAME, kernel_virtual_page_in_user_pool, NULL, NULL);
+}
+
 
 void
 vm_swap_free (size_t swap_slot)
 {
   lock_acquire(&swap_table_mutex);
-  ASSERT(swap_table[swap_slot] >=0);
-  --swap_table[swap_slot];
+  ASSERT(swap_table[swap_slot] > 0);
+  if(--swap_table[swap_slot] == 0)
+    swap_slot_release(swap_slot);
   lock_release(&swap_table_mutex);
-}
\ No newline at end of file
+}
+
+
+/* 빈 slot 하나를 sharing_proc_num개의 프로세스가 사용하도록 표시하고 그 번호를 반환한다.
+   current cluster에서 차례로 나누어준다. swap_table_mutex를 잡은 채로 호출해야한다. */
+static size_t swap_slot_alloc(int sharing_proc_num){
+  ASSERT(lock_held_by_current_thread(&swap_table_mutex));
+  ASSERT(sharing_proc_num > 0);
+
+  while(true){
+    if(current != NULL){
+      size_t first = cluster_first_slot(current);
+      size_t end = first + cluster_slot_cnt(current);
+      for(; current_next < end; ++current_next)
+        if(swap_table[current_next] == 0){
+          size_t swap_slot = current_next++;
+          swap_table[swap_slot] = sharing_proc_num;
+          current->free_cnt--;
+          return swap_slot;
+        }
+
+      /* 끝까지 나누어주었다. */
+      swap_retire_current();
+    }
+
+    /* 빈 cluster를 먼저 쓰고, 없다면 일부만 빈 cluster를 처음부터 살펴본다. */
+    if(!list_empty(&free_clusters))
+      current = list_entry(list_pop_front(&free_clusters), struct swap_cluster, elem);
+    else if(!list_empty(&partial_clusters))
+      current = list_entry(list_pop_front(&partial_clusters), struct swap_cluster, elem);
+    else
+      PANIC("swap device is full");
+    current_next = cluster_first_slot(current);
+  }
+}
+
+
+/* 다음 n번의 swap_slot_alloc()이 current에서 연속된 slot을 받도록 한다.
+   current의 남은 부분이 모자라면 빈 cluster로 바꾼다. 빈 cluster가 없다면 그대로 둔다.
+   swap_table_mutex를 잡은 채로 호출해야한다. */
+static void swap_reserve_run(size_t n){
+  ASSERT(lock_held_by_current_thread(&swap_table_mutex));
+
+  if(current != NULL){
+    size_t end = cluster_first_slot(current) + cluster_slot_cnt(current);
+    size_t i;
+    for(i = current_next; i < end && i < current_next + n; ++i)
+      if(swap_table[i] != 0)
+        break;
+    if(i == current_next + n)
+      return;
+  }
+  if(list_empty(&free_clusters))
+    return;
+
+  if(current != NULL)
+    swap_retire_current();
+  current = list_entry(list_pop_front(&free_clusters), struct swap_cluster, elem);
+  current_next = cluster_first_slot(current);
+}
+
+
+/* current를 내려놓고 남은 빈 slot의 개수에 맞는 목록으로 보낸다. */
+static void swap_retire_current(void){
+  ASSERT(current != NULL);
+
+  if(current->free_cnt == cluster_slot_cnt(current))
+    list_push_back(&free_clusters, &current->elem);
+  else if(current->free_cnt > 0)
+    list_push_back(&partial_clusters, &current->elem);
+  current = NULL;
+}
+
+
+/* 더 이상 사용하지 않는 swap_slot을 cluster에 돌려준다.
+   swap_table_mutex를 잡은 채로 호출해야한다. */
+static void swap_slot_release(size_t swap_slot){
+  struct swap_cluster* c = &clusters[swap_slot / SWAP_CLUSTER_SLOTS];
+
+  ASSERT(lock_held_by_current_thread(&swap_table_mutex));
+  ASSERT(swap_table[swap_slot] == 0);
+
+  swap_owners[swap_slot].t = NULL;
+  swap_owners[swap_slot].spte = NULL;
+  vm_zswap_invalidate(swap_slot);
+  c->free_cnt++;
+  if(c == current)
+    return;
+  if(c->free_cnt == 1){
+    /* 가득 차 있었다. */
+    if(c->free_cnt == cluster_slot_cnt(c))
+      list_push_back(&free_clusters, &c->elem);
+    else
+      list_push_back(&partial_clusters, &c->elem);
+  }
+  else if(c->free_cnt == cluster_slot_cnt(c)){
+    list_remove(&c->elem);
+    list_push_back(&free_clusters, &c->elem);
+  }
+}
+
+
+/* cluster C의 첫 slot 번호. */
+static size_t cluster_first_slot(const struct swap_cluster* c){
+  return (size_t)(c - clusters) * SWAP_CLUSTER_SLOTS;
+}
+
+
+/* cluster C에 속한 slot의 개수. 마지막 cluster는 SWAP_CLUSTER_SLOTS보다 적을 수 있다. */
+static size_t cluster_slot_cnt(const struct swap_cluster* c){
+  size_t first = cluster_first_slot(c);
+  return swap_table_len - first < SWAP_CLUSTER_SLOTS ? swap_table_len - first : SWAP_CLUSTER_SLOTS;
+}
@@ -1,9 +1,22 @@
 #ifndef VM_SWAP_H
 #define VM_SWAP_H
 
+#include <stddef.h>
+#include "devices/block.h"
+
+struct thread;
+struct supplemental_page_table_entry;
+
 void vm_swapsys_init(void);
 void vm_swap_in(size_t, void* );
+void vm_swap_in_async(size_t, void*, struct block_request*);
+void vm_swap_release(size_t);
 size_t vm_swap_out(void* ,int);
+size_t vm_swap_out_async(void* ,int, struct block_request*);
+void vm_swap_out_batch(void**, const int*, size_t, size_t*, struct block_request*);
 void vm_swap_free (size_t swap_slot);
 
+void vm_swap_set_owner(size_t, struct thread*, struct supplemental_page_table_entry*);
+size_t vm_swap_owned_neighbours(size_t, size_t, struct supplemental_page_table_entry**);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,320 @@
+#include "vm/zswap.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* swap device 앞에 놓이는 압축된 in-memory swap 계층.
+
+   evict된 page를 LZ 방식으로 압축해서 kernel pool의 page들(pool)에 보관하고,
+   pool이 가득 찼거나 잘 압축되지 않는 page만 swap device에 기록한다.
+   모든 word가 같은 page는 evict할 때 이미 걸러져 spte에 SAME_FILLED로 기록되므로 여기에 오지 않는다.
+
+   page는 swap slot을 key로 보관한다. swap.c는 어느 계층에 기록하든 slot을 먼저 할당하므로
+   spte, swap read-around 등은 page가 어디에 있는지 알 필요가 없다. */
+
+/* pool이 사용할 수 있는 kernel page의 최대 개수. kernel pool의 thread, buffer cache와 나누어 쓴다. */
+#define ZSWAP_POOL_PAGES 64
+
+/* 이보다 크게 압축되는 page는 보관해도 얻는 것이 적으므로 swap device에 기록한다. */
+#define ZSWAP_MAX_LENGTH (PGSIZE * 3 / 4)
+
+
+/* zbud: pool page 하나에 압축된 page를 최대 두 개(buddy) 보관한다.
+   first buddy는 page 앞에서부터, last buddy는 page 뒤에서부터 채운다.
+   공간은 ZBUD_CHUNK_SIZE 단위로 나누어주고, buddy가 하나뿐인 page는 빈 chunk의 개수별 목록에 둔다. */
+#define ZBUD_CHUNK_SIZE 64
+#define ZBUD_NCHUNKS (PGSIZE / ZBUD_CHUNK_SIZE)
+
+struct zbud_page{
+  struct list_elem elem;    /* unbuddied[빈 chunk 개수] 또는 buddied의 원소 */
+  uint8_t* page;            /* kernel pool에서 받은 page */
+  size_t first_chunks;      /* first buddy가 차지한 chunk의 개수, 비어있다면 0 */
+  size_t last_chunks;       /* last buddy가 차지한 chunk의 개수, 비어있다면 0 */
+};
+
+static struct list unbuddied[ZBUD_NCHUNKS];   /* buddy가 하나뿐인 page들 */
+static struct list buddied;                   /* buddy가 둘 다 있는 page들 */
+static size_t pool_pages;                     /* pool이 사용중인 kernel page의 개수 */
+
+/* 보관중인 page 하나. */
+struct zswap_entry{
+  struct zbud_page* zpage;  /* 압축된 데이터가 있는 pool page */
+  bool first;               /* first buddy인가 last buddy인가 */
+  size_t length;            /* 압축된 데이터의 길이(bytes) */
+};
+
+/* swap slot -> 보관중인 page. 보관하지 않는 slot은 NULL이다. */
+static struct zswap_entry** entries;
+static size_t entry_cnt;
+
+/* entries, pool, 압축용 hash table을 보호한다. */
+static struct lock zswap_lock;
+
+/* Statistics. */
+static unsigned long long stored_cnt;     /* 압축해서 보관한 page */
+static unsigned long long loaded_cnt;     /* 보관하다 다시 읽어간 page */
+static unsigned long long rejected_cnt;   /* 압축이 안되거나 pool이 가득 차서 swap device로 보낸 page */
+
+static size_t lz_compress(const uint8_t* src, uint8_t* dst, size_t dst_max);
+static void lz_decompress(const uint8_t* src, size_t src_len, uint8_t* dst);
+static struct zswap_entry* zbud_alloc(size_t length);
+static void zbud_free(struct zswap_entry* e);
+static uint8_t* zbud_data(const struct zswap_entry* e);
+
+
+/* slot_cnt개의 swap slot을 위한 zswap을 초기화한다. */
+void vm_zswap_init(size_t slot_cnt){
+  entry_cnt = slot_cnt;
+  entries = malloc(sizeof *entries * slot_cnt);
+  if(entries == NULL)
+    PANIC("zswap entries creation failed--swap system device is too large");
+  memset(entries, 0, sizeof *entries * slot_cnt);
+
+  for(size_t i = 0; i < ZBUD_NCHUNKS; ++i)
+    list_init(&unbuddied[i]);
+  list_init(&buddied);
+  pool_pages = 0;
+  lock_init(&zswap_lock);
+}
+
+
+/* kernel page PAGE를 swap_slot의 내용으로 보관하려 시도한다.
+   보관했다면 true, swap device에 기록해야 한다면 false를 반환한다. */
+bool vm_zswap_store(size_t swap_slot, const void* page){
+  /* 압축 결과를 잠시 담아두는 곳. kernel stack에 두기에는 크다. */
+  static uint8_t compressed[ZSWAP_MAX_LENGTH];
+  bool stored = false;
+
+  ASSERT(swap_slot < entry_cnt);
+
+  lock_acquire(&zswap_lock);
+  ASSERT(entries[swap_slot] == NULL);
+  size_t length = lz_compress(page, compressed, sizeof compressed);
+  struct zswap_entry* e = length != 0 ? zbud_alloc(length) : NULL;
+  if(e != NULL){
+    memcpy(zbud_data(e), compressed, length);
+    entries[swap_slot] = e;
+    stored_cnt++;
+    stored = true;
+  }
+  else
+    rejected_cnt++;
+  lock_release(&zswap_lock);
+  return stored;
+}
+
+
+/* swap_slot의 내용을 보관하고 있다면 kernel page PAGE에 풀어놓고 true를 반환한다.
+   보관하고 있지 않다면 false를 반환하고, 내용은 swap device에 있다.
+   swap cache가 slot을 잡고 있는 동안 다시 evict될 수 있으므로 보관은 slot이 해제될 때까지 계속한다. */
+bool vm_zswap_load(size_t swap_slot, void* page){
+  ASSERT(swap_slot < entry_cnt);
+
+  lock_acquire(&zswap_lock);
+  struct zswap_entry* e = entries[swap_slot];
+  if(e != NULL){
+    lz_decompress(zbud_data(e), e->length, page);
+    loaded_cnt++;
+  }
+  lock_release(&zswap_lock);
+  return e != NULL;
+}
+
+
+/* swap_slot이 해제되었다. 보관하던 내용이 있다면 버린다. */
+void vm_zswap_invalidate(size_t swap_slot){
+  ASSERT(swap_slot < entry_cnt);
+
+  lock_acquire(&zswap_lock);
+  struct zswap_entry* e = entries[swap_slot];
+  if(e != NULL)
+    zbud_free(e);
+  entries[swap_slot] = NULL;
+  lock_release(&zswap_lock);
+}
+
+
+void vm_zswap_print_stats(void){
+  if(entries == NULL)
+    return;
+  printf("zswap: %llu stored, %llu loaded, %llu rejected, %zu pool pages\n",
+         stored_cnt, loaded_cnt, rejected_cnt, pool_pages);
+}
+
+
+/* LZ77 계열의 간단한 압축(LZRW1과 비슷하다).
+
+   출력은 control byte 하나와 그 뒤의 item 최대 8개의 반복이다. control byte의 i번째 bit가
+   0이면 i번째 item은 literal 1 byte, 1이면 앞에 나왔던 데이터를 가리키는 match이다.
+   match는 2 byte: (offset >> 8) << 4 | (length - 3), offset & 0xff 이고,
+   length - 3이 15 이상이면 뒤에 1 byte를 더 붙여 length - 18을 기록한다.
+   match 후보는 3 byte의 hash마다 마지막으로 나타난 위치 하나만 기억한다. */
+#define LZ_HASH_BITS 12
+#define LZ_MIN_MATCH 3
+#define LZ_MAX_MATCH (LZ_MIN_MATCH + 15 + 255)
+#define LZ_MAX_OFFSET 0xfff
+
+/* 3 byte의 hash -> 마지막으로 나타난 위치 + 1 (0은 없음). zswap_lock이 보호한다. */
+static uint16_t lz_hash_table[1 << LZ_HASH_BITS];
+
+static unsigned lz_hash(const uint8_t* p){
+  return ((p[0] << 8 ^ p[1] << 4 ^ p[2]) * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/* page SRC를 압축해서 DST에 기록하고 그 길이를 반환한다.
+   DST_MAX bytes 안에 들어가지 않는다면 0을 반환한다. */
+static size_t lz_compress(const uint8_t* src, uint8_t* dst, size_t dst_max){
+  size_t in = 0, out = 0;
+  size_t ctrl = 0;
+  int ctrl_bit = 8;
+
+  memset(lz_hash_table, 0, sizeof lz_hash_table);
+  while(in < PGSIZE){
+    if(ctrl_bit == 8){
+      if(out >= dst_max)
+        return 0;
+      ctrl = out++;
+      dst[ctrl] = 0;
+      ctrl_bit = 0;
+    }
+
+    size_t length = 0, offset = 0;
+    if(in + LZ_MIN_MATCH <= PGSIZE){
+      unsigned h = lz_hash(src + in);
+      size_t candidate = lz_hash_table[h];
+      lz_hash_table[h] = in + 1;
+      if(candidate != 0 && in - (candidate - 1) <= LZ_MAX_OFFSET){
+        const uint8_t* match = src + candidate - 1;
+        while(in + length < PGSIZE && length < LZ_MAX_MATCH && match[length] == src[in + length])
+          ++length;
+        offset = in - (candidate - 1);
+      }
+    }
+
+    if(length >= LZ_MIN_MATCH){
+      size_t extra = length - LZ_MIN_MATCH;
+      if(out + (extra < 15 ? 2 : 3) > dst_max)
+        return 0;
+      dst[ctrl] |= 1 << ctrl_bit;
+      dst[out++] = (offset >> 8) << 4 | (extra < 15 ? extra : 15);
+      dst[out++] = offset & 0xff;
+      if(extra >= 15)
+        dst[out++] = extra - 15;
+      in += length;
+    }
+    else{
+      if(out >= dst_max)
+        return 0;
+      dst[out++] = src[in++];
+    }
+    ++ctrl_bit;
+  }
+  return out;
+}
+
+/* lz_compress()로 압축한 SRC_LEN bytes의 SRC를 page DST에 풀어놓는다. */
+static void lz_decompress(const uint8_t* src, size_t src_len, uint8_t* dst){
+  size_t in = 0, out = 0;
+
+  while(out < PGSIZE){
+    ASSERT(in < src_len);
+    uint8_t ctrl = src[in++];
+    for(int bit = 0; bit < 8 && out < PGSIZE; ++bit){
+      if(ctrl & (1 << bit)){
+        size_t offset = (size_t)(src[in] >> 4) << 8 | src[in + 1];
+        size_t length = (src[in] & 15) + LZ_MIN_MATCH;
+        if((src[in] & 15) == 15)
+          length += src[in + 2];
+        in += (src[in] & 15) == 15 ? 3 : 2;
+
+        ASSERT(offset != 0 && offset <= out && out + length <= PGSIZE);
+        /* 겹칠 수 있으므로 byte 단위로 복사한다. */
+        for(; length > 0; --length, ++out)
+          dst[out] = dst[out - offset];
+      }
+      else
+        dst[out++] = src[in++];
+    }
+  }
+}
+
+
+/* length bytes를 담을 자리를 pool에서 찾아 entry를 만든다. 자리가 없다면 NULL을 반환한다. */
+static struct zswap_entry* zbud_alloc(size_t length){
+  size_t chunks = DIV_ROUND_UP(length, ZBUD_CHUNK_SIZE);
+  struct zbud_page* zpage = NULL;
+  struct zswap_entry* e = malloc(sizeof *e);
+
+  if(e == NULL)
+    return NULL;
+
+  /* buddy가 하나뿐인 page 중 남은 자리가 가장 딱 맞는 page를 고른다. */
+  for(size_t i = chunks; i < ZBUD_NCHUNKS; ++i)
+    if(!list_empty(&unbuddied[i])){
+      zpage = list_entry(list_pop_front(&unbuddied[i]), struct zbud_page, elem);
+      break;
+    }
+
+  if(zpage == NULL){
+    if(pool_pages >= ZSWAP_POOL_PAGES || (zpage = malloc(sizeof *zpage)) == NULL){
+      free(e);
+      return NULL;
+    }
+    zpage->page = palloc_get_page(0);
+    if(zpage->page == NULL){
+      free(zpage);
+      free(e);
+      return NULL;
+    }
+    zpage->first_chunks = zpage->last_chunks = 0;
+    pool_pages++;
+  }
+
+  e->zpage = zpage;
+  e->length = length;
+  e->first = zpage->first_chunks == 0;
+  if(e->first)
+    zpage->first_chunks = chunks;
+  else
+    zpage->last_chunks = chunks;
+
+  if(zpage->first_chunks != 0 && zpage->last_chunks != 0)
+    list_push_back(&buddied, &zpage->elem);
+  else
+    list_push_back(&unbuddied[ZBUD_NCHUNKS - chunks], &zpage->elem);
+  return e;
+}
+
+/* entry E가 차지하던 자리를 pool에 돌려주고 E를 해제한다. */
+static void zbud_free(struct zswap_entry* e){
+  struct zbud_page* zpage = e->zpage;
+
+  list_remove(&zpage->elem);
+  if(e->first)
+    zpage->first_chunks = 0;
+  else
+    zpage->last_chunks = 0;
+  free(e);
+
+  if(zpage->first_chunks == 0 && zpage->last_chunks == 0){
+    palloc_free_page(zpage->page);
+    free(zpage);
+    pool_pages--;
+  }
+  else
+    list_push_back(&unbuddied[ZBUD_NCHUNKS - zpage->first_chunks - zpage->last_chunks], &zpage->elem);
+}
+
+/* entry E의 압축된 데이터가 있는 곳. */
+static uint8_t* zbud_data(const struct zswap_entry* e){
+  if(e->first)
+    return e->zpage->page;
+  return e->zpage->page + PGSIZE - e->zpage->last_chunks * ZBUD_CHUNK_SIZE;
+}
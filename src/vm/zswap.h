@@ -0,0 +1,13 @@
+#ifndef VM_ZSWAP_H
+#define VM_ZSWAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+void vm_zswap_init(size_t);
+bool vm_zswap_store(size_t, const void*);
+bool vm_zswap_load(size_t, void*);
+void vm_zswap_invalidate(size_t);
+void vm_zswap_print_stats(void);
+
+#endif /* vm/zswap.h */